@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Per-call cost of the X11 backend. Run under Xvfb (make bench), without a window manager.
+// SGL must be built with SGL_HAVE_EGL for the GLES context; it is reported as null if EGL fails.
+//
+//    init/deinit for legacy, modern (3.2 core) and GLES 2 contexts
+//    sgl_is_alive() with 0, 100 and 10000 events injected with XTest before the call
+//    sgl_check_resize(), sgl_has_focus(), sgl_swap_buffers() at interval 0, sgl_get_proc_address()
+//
+// Prints one JSON object. Times are CLOCK_MONOTONIC nanoseconds.
+
+#define SGL_EXPOSE_INTERNAL
+#include "sgl.h"
+
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define INIT_RUNS 10
+#define CALL_BATCH 1000
+#define CALL_SAMPLES 200
+#define SWAP_FRAMES 300
+
+static uint64_t now_ns(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec * UINT64_C(1000000000) + tv.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+   uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+   return x < y ? -1 : x > y;
+}
+
+// Sorts samples in place.
+static void print_stats(const char *name, uint64_t *samples, unsigned num)
+{
+   qsort(samples, num, sizeof(*samples), cmp_u64);
+   printf("\"%s\":{\"samples\":%u,\"min_ns\":%llu,\"median_ns\":%llu,\"max_ns\":%llu}",
+         name, num, (unsigned long long)samples[0],
+         (unsigned long long)samples[num / 2], (unsigned long long)samples[num - 1]);
+}
+
+static const struct sgl_context_options *context_opts(int style)
+{
+   static struct sgl_context_options opts;
+   opts = (struct sgl_context_options) {
+      .res         = { .width = 640, .height = 480 },
+      .screen_type = SGL_SCREEN_WINDOWED,
+      .title       = "sgl bench",
+   };
+
+   opts.context.style = style;
+   if (style == SGL_CONTEXT_MODERN)
+   {
+      opts.context.major = 3;
+      opts.context.minor = 2;
+   }
+   else if (style == SGL_CONTEXT_GLES)
+      opts.context.major = 2;
+
+   return &opts;
+}
+
+static void bench_init(const char *name, int style)
+{
+   uint64_t init[INIT_RUNS], deinit[INIT_RUNS];
+
+   printf("\"%s\":", name);
+   for (unsigned i = 0; i < INIT_RUNS; i++)
+   {
+      uint64_t start = now_ns();
+      if (!sgl_init(context_opts(style)))
+      {
+         printf("null");
+         return;
+      }
+      init[i] = now_ns() - start;
+
+      start = now_ns();
+      sgl_deinit();
+      deinit[i] = now_ns() - start;
+   }
+
+   // The first init fills the capability cache, later ones read it.
+   printf("{\"first_init_ns\":%llu,", (unsigned long long)init[0]);
+   print_stats("init", init, INIT_RUNS);
+   putchar(',');
+   print_stats("deinit", deinit, INIT_RUNS);
+   putchar('}');
+}
+
+static unsigned g_delivered;
+
+static void key_cb(int key, int pressed)
+{
+   (void)key;
+   (void)pressed;
+   g_delivered++;
+}
+
+static void mouse_move_cb(int x, int y)
+{
+   (void)x;
+   (void)y;
+   g_delivered++;
+}
+
+struct injector
+{
+   Display *dpy;
+   unsigned keycode;
+   int x, y;
+};
+
+// Moves the pointer into the window first: without a window manager, keyboard focus follows it.
+static int injector_init(struct injector *inj)
+{
+   inj->dpy = XOpenDisplay(NULL);
+   if (!inj->dpy)
+      return 0;
+
+   int event_base, error_base, major, minor;
+   if (!XTestQueryExtension(inj->dpy, &event_base, &error_base, &major, &minor))
+   {
+      fprintf(stderr, "bench: XTest is not available.\n");
+      XCloseDisplay(inj->dpy);
+      return 0;
+   }
+
+   struct sgl_handles handles;
+   sgl_get_handles(&handles);
+
+   Window child;
+   XTranslateCoordinates(inj->dpy, handles.win, DefaultRootWindow(inj->dpy),
+         0, 0, &inj->x, &inj->y, &child);
+   inj->keycode = XKeysymToKeycode(inj->dpy, XK_a);
+
+   XTestFakeMotionEvent(inj->dpy, -1, inj->x + 320, inj->y + 240, CurrentTime);
+   XSync(inj->dpy, False);
+   return 1;
+}
+
+// Alternates pointer moves and key presses/releases, then waits for the server to process them.
+static void inject(struct injector *inj, unsigned num)
+{
+   for (unsigned i = 0; i < num; i++)
+   {
+      if (i & 1)
+         XTestFakeKeyEvent(inj->dpy, inj->keycode, (i & 2) == 0, CurrentTime);
+      else
+         XTestFakeMotionEvent(inj->dpy, -1, inj->x + 100 + (i & 255), inj->y + 100, CurrentTime);
+   }
+   XSync(inj->dpy, False);
+}
+
+static void bench_is_alive(struct injector *inj, unsigned events, unsigned runs)
+{
+   uint64_t *samples = calloc(runs, sizeof(*samples));
+   unsigned delivered = 0;
+
+   for (unsigned i = 0; i < runs; i++)
+   {
+      inject(inj, events);
+
+      g_delivered = 0;
+      uint64_t start = now_ns();
+      sgl_is_alive();
+      samples[i] = now_ns() - start;
+      delivered += g_delivered;
+   }
+
+   printf("\"%u\":{\"events\":%u,\"delivered_per_call\":%u,", events, events, delivered / runs);
+   print_stats("is_alive", samples, runs);
+   putchar('}');
+   free(samples);
+}
+
+// Calls are too short to time one by one. Each sample is a batch, reported per call.
+#define BENCH_CALLS(name, call) do { \
+   uint64_t samples[CALL_SAMPLES]; \
+   for (unsigned s = 0; s < CALL_SAMPLES; s++) \
+   { \
+      uint64_t start = now_ns(); \
+      for (unsigned c = 0; c < CALL_BATCH; c++) \
+         call; \
+      samples[s] = (now_ns() - start) / CALL_BATCH; \
+   } \
+   print_stats(name, samples, CALL_SAMPLES); \
+} while (0)
+
+static const char *const proc_names[] = {
+   "glGenBuffers",
+   "glBindBuffer",
+   "glBufferData",
+   "glCreateShader",
+   "glDrawArrays",
+   "glXSwapIntervalEXT",
+};
+
+int main(void)
+{
+   printf("{\"bench\":\"sgl\",\"init\":{");
+   bench_init("legacy", SGL_CONTEXT_LEGACY);
+   putchar(',');
+   bench_init("modern", SGL_CONTEXT_MODERN);
+   putchar(',');
+   bench_init("gles", SGL_CONTEXT_GLES);
+   putchar('}');
+
+   if (!sgl_init(context_opts(SGL_CONTEXT_LEGACY)))
+   {
+      printf("}\n");
+      fprintf(stderr, "bench: sgl_init() failed.\n");
+      return 1;
+   }
+
+   struct sgl_input_callbacks cbs = {
+      .key_cb        = key_cb,
+      .mouse_move_cb = mouse_move_cb,
+   };
+   sgl_set_input_callbacks(&cbs);
+
+   // Let the window map before events are sent to it.
+   for (unsigned i = 0; i < 100; i++)
+   {
+      sgl_is_alive();
+      struct timespec tv = { 0, 1000000 };
+      nanosleep(&tv, NULL);
+   }
+
+   struct injector inj;
+   if (!injector_init(&inj))
+   {
+      printf("}\n");
+      sgl_deinit();
+      return 1;
+   }
+
+   printf(",\"is_alive\":{");
+   bench_is_alive(&inj, 0, 1000);
+   putchar(',');
+   bench_is_alive(&inj, 100, 200);
+   putchar(',');
+   bench_is_alive(&inj, 10000, 20);
+   putchar('}');
+
+   unsigned width, height;
+   putchar(',');
+   BENCH_CALLS("check_resize", sgl_check_resize(&width, &height));
+   putchar(',');
+   BENCH_CALLS("has_focus", sgl_has_focus());
+   putchar(',');
+   BENCH_CALLS("get_proc_address",
+         sgl_get_proc_address(proc_names[c % (sizeof(proc_names) / sizeof(proc_names[0]))]));
+
+   sgl_set_swap_interval(0);
+   uint64_t swaps[SWAP_FRAMES];
+   for (unsigned i = 0; i < SWAP_FRAMES; i++)
+   {
+      glClear(GL_COLOR_BUFFER_BIT);
+      uint64_t start = now_ns();
+      sgl_swap_buffers();
+      swaps[i] = now_ns() - start;
+      sgl_is_alive();
+   }
+   putchar(',');
+   print_stats("swap_interval_0", swaps, SWAP_FRAMES);
+   printf("}\n");
+
+   XCloseDisplay(inj.dpy);
+   sgl_deinit();
+   return 0;
+}
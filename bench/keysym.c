@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Key translation microbenchmark. Run under Xvfb (make bench).
+// Compares the keycode table translate_event() indexes with what key events used to cost:
+// XLookupKeysym(event, 0) followed by a linear scan of lut_binds.
+// SGL is compiled in to reach the static table. Prints one JSON object.
+
+#include "sgl.c"
+
+#define KEY_EVENTS (1 << 20)
+#define RUNS 5
+
+static double now(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1e9;
+}
+
+static int scan_translate(XKeyEvent *event)
+{
+   return keysym_to_sglk(XLookupKeysym(event, 0));
+}
+
+static int table_translate(const XEvent *event)
+{
+   struct sgl_event ev;
+   return translate_event(event, &ev) ? ev.code : SGLK_UNKNOWN;
+}
+
+int main(void)
+{
+   Display *dpy = XOpenDisplay(NULL);
+   if (!dpy)
+   {
+      fprintf(stderr, "keysym: Cannot open display.\n");
+      return 1;
+   }
+
+   init_keycode_map(dpy, g_keycode_map);
+
+   int min_code, max_code;
+   XDisplayKeycodes(dpy, &min_code, &max_code);
+
+   // Keycodes in a fixed pseudo-random order, so the scan doesn't always stop at the same entry.
+   XEvent *events = calloc(KEY_EVENTS, sizeof(*events));
+   if (!events)
+      return 1;
+
+   uint32_t seed = 1;
+   for (unsigned i = 0; i < KEY_EVENTS; i++)
+   {
+      seed = seed * 1664525u + 1013904223u;
+      events[i].xkey = (XKeyEvent) {
+         .type    = KeyPress,
+         .display = dpy,
+         .keycode = min_code + (seed >> 16) % (max_code - min_code + 1),
+      };
+   }
+
+   // The table only differs where the unshifted level is NoSymbol.
+   unsigned mismatches = 0, known = 0;
+   for (int code = min_code; code <= max_code; code++)
+   {
+      XEvent event = { .xkey = { .type = KeyPress, .display = dpy, .keycode = code } };
+      int table = table_translate(&event);
+      known += table != SGLK_UNKNOWN;
+      mismatches += table != scan_translate(&event.xkey);
+   }
+
+   double best_scan = 1e9, best_table = 1e9;
+   volatile unsigned sink = 0;
+   for (int run = 0; run < RUNS; run++)
+   {
+      unsigned sum = 0;
+      double start = now();
+      for (unsigned i = 0; i < KEY_EVENTS; i++)
+         sum += scan_translate(&events[i].xkey);
+      double scan = now() - start;
+
+      start = now();
+      for (unsigned i = 0; i < KEY_EVENTS; i++)
+         sum += table_translate(&events[i]);
+      double table = now() - start;
+
+      sink += sum;
+      if (scan < best_scan)
+         best_scan = scan;
+      if (table < best_table)
+         best_table = table;
+   }
+   (void)sink;
+
+   printf("{\"bench\":\"keysym\",\"events\":%u,\"keycodes\":%d,\"known_keycodes\":%u,"
+         "\"lut_binds\":%u,\"mismatches\":%u,"
+         "\"scan_ns_per_event\":%.2f,\"table_ns_per_event\":%.2f,\"speedup\":%.1f}\n",
+         KEY_EVENTS, max_code - min_code + 1, known,
+         (unsigned)(sizeof(lut_binds) / sizeof(lut_binds[0])), mismatches,
+         best_scan * 1e9 / KEY_EVENTS, best_table * 1e9 / KEY_EVENTS,
+         best_table > 0.0 ? best_scan / best_table : 0.0);
+
+   free(events);
+   XCloseDisplay(dpy);
+   return 0;
+}
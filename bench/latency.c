@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Input latency harness. Run under Xvfb (make bench), without a window manager.
+// Key presses, button presses and pointer moves are injected with XTest from a second
+// connection, one at a time, and timed on CLOCK_MONOTONIC from just before the request is
+// sent until SGL hands the event to a callback, or returns it from sgl_poll_events().
+// Unlike the SGL_PROFILE_*_LATENCY histograms, this doesn't depend on server timestamps,
+// but it measures a busy loop around sgl_is_alive() rather than a real frame loop.
+//
+// Modes: "sync" (callbacks from sgl_is_alive()), "threaded" (input.threaded) and "poll"
+// (sgl_poll_events()). With SGL built with SGL_PROFILE, the passive histograms recorded
+// during each mode are printed next to the measured distribution for comparison.
+// Prints one JSON object. Times are in nanoseconds.
+
+#define SGL_EXPOSE_INTERNAL
+#include "sgl.h"
+
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLES 500
+#define TIMEOUT_NS UINT64_C(100000000)
+
+enum { MODE_SYNC, MODE_THREADED, MODE_POLL, MODES };
+static const char *const mode_names[MODES] = { "sync", "threaded", "poll" };
+
+enum { TYPE_KEY, TYPE_MOUSE_BUTTON, TYPE_MOUSE_MOVE, TYPES };
+static const char *const type_names[TYPES] = { "key", "mouse_button", "mouse_move" };
+static const int type_events[TYPES] = { SGL_EVENT_KEY, SGL_EVENT_MOUSE_BUTTON, SGL_EVENT_MOUSE_MOVE };
+static const int type_phases[TYPES] = {
+   SGL_PROFILE_KEY_LATENCY, SGL_PROFILE_MOUSE_BUTTON_LATENCY, SGL_PROFILE_MOUSE_MOVE_LATENCY,
+};
+
+static uint64_t now_ns(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec * UINT64_C(1000000000) + tv.tv_nsec;
+}
+
+static void sleep_ms(unsigned ms)
+{
+   struct timespec tv = { 0, ms * 1000000L };
+   nanosleep(&tv, NULL);
+}
+
+// Set by the callbacks when the event type being waited for arrives.
+static int g_wanted;
+static uint64_t g_received;
+
+static void key_cb(int key, int pressed)
+{
+   (void)key;
+   (void)pressed;
+   if (g_wanted == SGL_EVENT_KEY && !g_received)
+      g_received = now_ns();
+}
+
+static void mouse_button_cb(int button, int pressed, int x, int y)
+{
+   (void)button;
+   (void)pressed;
+   (void)x;
+   (void)y;
+   if (g_wanted == SGL_EVENT_MOUSE_BUTTON && !g_received)
+      g_received = now_ns();
+}
+
+static void mouse_move_cb(int x, int y)
+{
+   (void)x;
+   (void)y;
+   if (g_wanted == SGL_EVENT_MOUSE_MOVE && !g_received)
+      g_received = now_ns();
+}
+
+static void pump(int mode)
+{
+   if (mode != MODE_POLL)
+   {
+      sgl_is_alive();
+      return;
+   }
+
+   struct sgl_event events[64];
+   unsigned num = sgl_poll_events(events, 64);
+   uint64_t now = now_ns();
+   for (unsigned i = 0; i < num; i++)
+   {
+      if (events[i].type == g_wanted && !g_received)
+         g_received = now;
+   }
+}
+
+struct injector
+{
+   Display *dpy;
+   unsigned keycode;
+   int x, y;
+};
+
+static int injector_init(struct injector *inj)
+{
+   inj->dpy = XOpenDisplay(NULL);
+   if (!inj->dpy)
+      return 0;
+
+   int event_base, error_base, major, minor;
+   if (!XTestQueryExtension(inj->dpy, &event_base, &error_base, &major, &minor))
+   {
+      fprintf(stderr, "latency: XTest is not available.\n");
+      XCloseDisplay(inj->dpy);
+      return 0;
+   }
+
+   struct sgl_handles handles;
+   sgl_get_handles(&handles);
+
+   Window child;
+   XTranslateCoordinates(inj->dpy, handles.win, DefaultRootWindow(inj->dpy),
+         0, 0, &inj->x, &inj->y, &child);
+   inj->keycode = XKeysymToKeycode(inj->dpy, XK_a);
+
+   // Without a window manager, keyboard focus follows the pointer.
+   XTestFakeMotionEvent(inj->dpy, -1, inj->x + 320, inj->y + 240, CurrentTime);
+   XSync(inj->dpy, False);
+   return 1;
+}
+
+// Presses on even samples, releases on odd ones, so nothing is left held down.
+static void inject(struct injector *inj, int type, unsigned sample)
+{
+   switch (type)
+   {
+      case TYPE_KEY:
+         XTestFakeKeyEvent(inj->dpy, inj->keycode, !(sample & 1), CurrentTime);
+         break;
+      case TYPE_MOUSE_BUTTON:
+         XTestFakeButtonEvent(inj->dpy, 1, !(sample & 1), CurrentTime);
+         break;
+      default:
+         XTestFakeMotionEvent(inj->dpy, -1, inj->x + 300 + (sample & 1) * 40, inj->y + 240, CurrentTime);
+         break;
+   }
+   XFlush(inj->dpy);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+   uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+   return x < y ? -1 : x > y;
+}
+
+static void print_distribution(uint64_t *samples, unsigned num, unsigned lost)
+{
+   if (!num)
+   {
+      printf("{\"samples\":0,\"lost\":%u}", lost);
+      return;
+   }
+
+   qsort(samples, num, sizeof(*samples), cmp_u64);
+   printf("{\"samples\":%u,\"lost\":%u,\"min\":%llu,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+         num, lost, (unsigned long long)samples[0],
+         (unsigned long long)samples[num / 2],
+         (unsigned long long)samples[num * 9 / 10],
+         (unsigned long long)samples[num * 99 / 100],
+         (unsigned long long)samples[num - 1]);
+}
+
+static void measure(struct injector *inj, int mode, int type)
+{
+   static uint64_t samples[SAMPLES];
+   unsigned num = 0, lost = 0;
+
+   for (unsigned i = 0; i < SAMPLES; i++)
+   {
+      // Drain anything left over before starting the clock.
+      pump(mode);
+      g_wanted = type_events[type];
+      g_received = 0;
+
+      uint64_t start = now_ns();
+      inject(inj, type, i);
+      while (!g_received && now_ns() - start < TIMEOUT_NS)
+         pump(mode);
+
+      if (g_received)
+         samples[num++] = g_received - start;
+      else
+         lost++;
+
+      g_wanted = 0;
+      sleep_ms(1);
+   }
+
+   print_distribution(samples, num, lost);
+}
+
+static int run_mode(int mode)
+{
+   struct sgl_context_options opts = {
+      .res         = { .width = 640, .height = 480 },
+      .screen_type = SGL_SCREEN_WINDOWED,
+      .title       = "sgl latency",
+   };
+   opts.input.threaded = mode == MODE_THREADED;
+
+   if (!sgl_init(&opts))
+      return 0;
+
+   if (mode == MODE_POLL)
+   {
+      sgl_set_event_mask(SGL_EVENT_MASK(SGL_EVENT_KEY) |
+            SGL_EVENT_MASK(SGL_EVENT_MOUSE_BUTTON) | SGL_EVENT_MASK(SGL_EVENT_MOUSE_MOVE));
+   }
+   else
+   {
+      struct sgl_input_callbacks cbs = {
+         .key_cb          = key_cb,
+         .mouse_button_cb = mouse_button_cb,
+         .mouse_move_cb   = mouse_move_cb,
+      };
+      sgl_set_input_callbacks(&cbs);
+   }
+
+   // Let the window map before events are sent to it.
+   for (unsigned i = 0; i < 100; i++)
+   {
+      pump(mode);
+      sleep_ms(1);
+   }
+
+   struct injector inj;
+   if (!injector_init(&inj))
+   {
+      sgl_deinit();
+      return 0;
+   }
+
+   printf("%s\"%s\":{", mode ? "," : "", mode_names[mode]);
+   for (int type = 0; type < TYPES; type++)
+   {
+      printf("%s\"%s\":", type ? "," : "", type_names[type]);
+      measure(&inj, mode, type);
+   }
+
+   struct sgl_profile profile;
+   printf(",\"passive\":");
+   if (sgl_get_profile(&profile))
+   {
+      for (int type = 0; type < TYPES; type++)
+      {
+         const struct sgl_profile_phase *phase = &profile.phases[type_phases[type]];
+         printf("%s\"%s\":{\"samples\":%llu,\"p50\":%llu,\"p99\":%llu}", type ? "," : "{",
+               type_names[type], (unsigned long long)phase->count,
+               (unsigned long long)phase->p50, (unsigned long long)phase->p99);
+      }
+      putchar('}');
+   }
+   else
+      printf("null");
+   putchar('}');
+
+   XCloseDisplay(inj.dpy);
+   sgl_deinit();
+   return 1;
+}
+
+int main(void)
+{
+   printf("{\"bench\":\"input_latency\",\"samples\":%u,\"modes\":{", SAMPLES);
+   for (int mode = 0; mode < MODES; mode++)
+   {
+      if (!run_mode(mode))
+      {
+         printf("}}\n");
+         fprintf(stderr, "latency: %s mode failed.\n", mode_names[mode]);
+         return 1;
+      }
+   }
+   printf("}}\n");
+   return 0;
+}
@@ -17,6 +17,8 @@
 #ifndef SGL_H__
 #define SGL_H__
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -24,6 +26,22 @@ extern "C" {
 #define SGL_SCREEN_WINDOWED 0
 #define SGL_SCREEN_FULLSCREEN 1
 #define SGL_SCREEN_WINDOWED_FULLSCREEN 2
+/* Offscreen context without a window, rendering to a framebuffer object of the requested size.
+ * Width and height must not be 0. See sgl_get_framebuffer().
+ * Does not need a display server if EGL is available. (X11 only.) */
+#define SGL_SCREEN_HEADLESS 3
+
+/* Use swap interval. Also returned if present mode can't be controlled. */
+#define SGL_PRESENT_MODE_DEFAULT 0
+/* No VSync. Tears, never waits. */
+#define SGL_PRESENT_MODE_IMMEDIATE 1
+/* VSync. */
+#define SGL_PRESENT_MODE_FIFO 2
+/* VSync, but tears instead of waiting for the next vblank if a frame is late.
+ * Emulated by toggling swap interval on missed vblanks if the driver can't do it. */
+#define SGL_PRESENT_MODE_FIFO_RELAXED 3
+/* VSync with at most one frame queued ahead of the display for low latency (emulated). */
+#define SGL_PRESENT_MODE_MAILBOX 4
 
 #define SGL_CONTEXT_LEGACY 0
 #define SGL_CONTEXT_MODERN 1
@@ -39,8 +57,21 @@ struct sgl_resolution
    /* Requested height of window. Ignored if using windowed fullscreen. */
    unsigned height;
 
-   /* Monitor index. 0 = First monitor, 1 = Second monitor, etc ... */
+   /* Monitor index. 0 = First monitor, 1 = Second monitor, etc ...
+    * Only used if SGL is built with SGL_HAVE_XRANDR (X11, link with -lXrandr). Monitors are the
+    * active outputs, the primary one first, then the others left to right, top to bottom. */
    unsigned monitor_index;
+
+   /* Refresh rate in millihertz, e.g. 59940. Reported by sgl_get_desktop_modes(). 0 if unknown.
+    * For SGL_SCREEN_FULLSCREEN with RandR, the rate to pick the mode by. 0 = see content_mhz. */
+   unsigned refresh_mhz;
+
+   /* For SGL_SCREEN_FULLSCREEN with RandR and refresh_mhz = 0: frame rate of the content in
+    * millihertz, e.g. 23976. The mode closest to an integer multiple of it is picked.
+    * If both are 0, the desktop refresh rate is kept if possible.
+    * The size closest to width x height (preferring larger modes) always takes priority,
+    * and only the monitor's own CRTC is switched. It is restored in sgl_deinit(). */
+   unsigned content_mhz;
 };
 
 struct sgl_context_options
@@ -56,6 +87,18 @@ struct sgl_context_options
       /* Major/minor OpenGL version used for modern contexts. */
       unsigned major;
       unsigned minor;
+
+      /* Oldest acceptable version if major.minor is not supported. Older core versions are
+       * tried in turn down to this one. 0 = no fallback. (X11/GLX only.)
+       * Query GL_MAJOR_VERSION/GL_MINOR_VERSION for the version actually created.
+       *
+       * The version, framebuffer config and swap control extensions GLX settles on are
+       * cached in $XDG_CACHE_HOME/sgl-caps, or $SGL_CAPS_CACHE if set (empty disables it). */
+      unsigned min_major;
+      unsigned min_minor;
+
+      /* If non-zero, sgl_create_shared_context() can be used. (X11 only.) */
+      unsigned shared;
    } context;
 
    /* Window type. */
@@ -69,6 +112,34 @@ struct sgl_context_options
 
    /* Initial window title. */
    const char *title;
+
+   /* Function loading. */
+   struct
+   {
+      /* Entry points to resolve into the dispatch table of each context, e.g. "glGenBuffers".
+       * Only these are resolved. SGL has no built-in list of core entry points per GL version,
+       * so core functions the application calls through the table must be named here as well.
+       * The array must stay valid until sgl_deinit(). */
+      const char * const *procs;
+      unsigned num_procs;
+   } gl;
+
+   /* Input handling. */
+   struct
+   {
+      /* If non-zero, input is read on a separate thread and queued
+       * until the next call to sgl_is_alive() or sgl_poll_events(). (X11 only.)
+       * SGL calls XInitThreads() before opening its first connection. An application that
+       * makes its own Xlib calls before that must call XInitThreads() first itself. */
+      unsigned threaded;
+
+      /* Capacity of the threaded input queue. Rounded up to a power of two.
+       * 0 = default (1024). sgl_init() fails above 1048576. */
+      unsigned queue_size;
+   } input;
+
+   /* SGL_PRESENT_MODE_*. Overrides swap_interval if not SGL_PRESENT_MODE_DEFAULT. */
+   int present_mode;
 };
 
 #define GL_GLEXT_PROTOTYPES
@@ -128,6 +199,8 @@ struct sgl_handles;
 
 /* Get information about the available desktop modes.
  * modes[0] will refer to the current desktop resolution.
+ * With RandR, every monitor's modes are listed in monitor order, each starting with its current mode.
+ * The list is cached until the screen configuration changes.
  * Can be called before sgl_init().
  * The pointer must be free'd using free(). */
 struct sgl_resolution *sgl_get_desktop_modes(unsigned *num_modes);
@@ -135,39 +208,420 @@ struct sgl_resolution *sgl_get_desktop_modes(unsigned *num_modes);
 int sgl_init(const struct sgl_context_options *opts);
 void sgl_deinit(void);
 
+/* Time spent in each step of the last sgl_init(), in microseconds. Steps that didn't run are 0.
+ * Headless contexts count connecting to a display as part of context. (X11 only.) */
+struct sgl_init_timing
+{
+   /* Opening display connections. */
+   unsigned connect;
+   /* Choosing a framebuffer config and visual. */
+   unsigned config;
+   /* Mode switch, window creation and setup. */
+   unsigned window;
+   /* Context creation, binding and function loading. */
+   unsigned context;
+   /* Waiting for the window to be mapped. Overlaps context creation on the server side. */
+   unsigned map;
+   /* Swap control, frame timing and the input thread. */
+   unsigned setup;
+   unsigned total;
+};
+
+int sgl_get_init_timing(struct sgl_init_timing *timing);
+
 void sgl_set_window_title(const char *title);
 
-/* Check if window was resized. Might be resized even if the user didn't explicitly resize. */
+/* Check if window was resized. Might be resized even if the user didn't explicitly resize.
+ * Resizes are picked up by sgl_is_alive(), so this does not talk to the window system.
+ * Headless contexts are never resized. */
 int sgl_check_resize(unsigned *width, unsigned *height);
 
+/* Framebuffer object to render to. It is bound by sgl_init(), so it only needs to be
+ * rebound where one would otherwise bind framebuffer 0.
+ * 0 (the window system framebuffer) unless using SGL_SCREEN_HEADLESS. */
+unsigned sgl_get_framebuffer(void);
+
 void sgl_set_swap_interval(unsigned interval);
+/* For headless contexts this only flushes. Frames are never throttled. */
 void sgl_swap_buffers(void);
 
+/* Set present mode (SGL_PRESENT_MODE_*). Returns the mode that was actually achieved. */
+int sgl_set_present_mode(int mode);
+
+/* Frame timing. Timestamps are in microseconds. */
+#define SGL_FRAME_STATS_HISTORY 16
+
+/* Presentation times are CPU timestamps taken when swap returned. */
+#define SGL_TIMING_CPU 0
+/* Presentation times are queried with GLX_OML_sync_control after swap. */
+#define SGL_TIMING_OML 1
+/* Presentation times are reported by the driver with GLX_INTEL_swap_event. */
+#define SGL_TIMING_INTEL_SWAP_EVENT 2
+
+struct sgl_frame_timing
+{
+   /* Swap count of this frame, starting at 1. */
+   uint64_t sbc;
+   /* Vertical retrace count frame was presented at. 0 if unknown or not yet presented. */
+   uint64_t msc;
+   /* Presentation time. 0 if not yet presented. */
+   int64_t ust;
+   /* CPU time before and after the swap call. */
+   int64_t cpu_swap_begin;
+   int64_t cpu_swap_end;
+};
+
+struct sgl_frame_stats
+{
+   /* SGL_TIMING_* */
+   int source;
+   /* Refresh period of the display. 0 if unknown. */
+   unsigned refresh_period;
+   /* Vertical retraces missed with respect to swap interval. */
+   uint64_t missed_vblanks;
+   /* Frames swapped since sgl_init(). */
+   uint64_t frames;
+   /* Recent frames, oldest first. */
+   unsigned num_history;
+   struct sgl_frame_timing history[SGL_FRAME_STATS_HISTORY];
+};
+
+int sgl_get_frame_stats(struct sgl_frame_stats *stats);
+
+struct sgl_present_prediction
+{
+   /* Estimated presentation time of the frame being built, in the clock of sgl_frame_timing::ust. */
+   int64_t present_time;
+   /* Estimated time between presented frames. */
+   unsigned frame_interval;
+};
+
+/* Predict when the frame to be swapped next will be displayed.
+ * Returns SGL_ERROR until enough frames have been swapped to make an estimate. */
+int sgl_predict_next_present(struct sgl_present_prediction *pred);
+
+/* Asynchronous frame capture. While active, sgl_swap_buffers() queues a readback of the frame
+ * into a ring of pixel buffer objects. Frames become available a few swaps later without stalling.
+ * Needs pixel buffer objects (OpenGL 2.1 or OpenGL ES 3.0).
+ * Multisampled headless framebuffers can't be captured. */
+#define SGL_PIXEL_FORMAT_RGBA 0
+#define SGL_PIXEL_FORMAT_BGRA 1
+
+/* Maximum number of frames in flight. */
+#define SGL_CAPTURE_MAX_DEPTH 8
+
+struct sgl_capture_options
+{
+   /* SGL_PIXEL_FORMAT_* of captured frames. */
+   int format;
+   /* Number of frames in flight before frames are dropped. 0 = default (3). */
+   unsigned depth;
+   /* If non-zero, rows are returned top to bottom instead of OpenGL's bottom to top. */
+   int flip;
+};
+
+struct sgl_captured_frame
+{
+   /* Valid until the next call to sgl_get_captured_frame() or sgl_stop_capture(). */
+   const void *data;
+   unsigned width;
+   unsigned height;
+   /* Bytes between rows. */
+   unsigned stride;
+   int format;
+   /* Swap count and swap time, as in sgl_frame_timing. */
+   uint64_t sbc;
+   int64_t cpu_swap_begin;
+   /* Frames not captured so far because all buffers in the ring were in flight. */
+   uint64_t dropped;
+};
+
+int sgl_start_capture(const struct sgl_capture_options *opts);
+/* Capture keeps running while frame export or recording still use it. */
+void sgl_stop_capture(void);
+
+/* Returns SGL_TRUE and the oldest captured frame if it has finished reading back.
+ * Never blocks. Call repeatedly to drain several frames. Must be called from the rendering thread. */
+int sgl_get_captured_frame(struct sgl_captured_frame *frame);
+
+/* Shared memory frame export. Frames are captured as with sgl_start_capture() and published into
+ * a POSIX shared memory object that other processes can map. Layout and protocol are in sgl_export.h.
+ * Starts frame capture if it isn't running. While exporting, finished frames are retrieved
+ * in sgl_swap_buffers(), so sgl_get_captured_frame() might not see them. (X11 only.) */
+struct sgl_export_options
+{
+   /* Name passed to shm_open(), e.g. "/sgl-frames". The object is unlinked by sgl_stop_export(). */
+   const char *name;
+   /* Frames in the ring. 0 = default (3). */
+   unsigned num_slots;
+   /* Size of the largest frame to export. 0 = current size. */
+   unsigned max_width;
+   unsigned max_height;
+   /* SGL_PIXEL_FORMAT_* of exported frames. */
+   int format;
+};
+
+int sgl_start_export(const struct sgl_export_options *opts);
+void sgl_stop_export(void);
+
+/* Frame recording. Frames are captured as with sgl_start_capture() and handed to a writer thread
+ * through a bounded queue. Conversion and disk writes happen on that thread. (X11 only.) */
+#define SGL_RECORD_Y4M 0 /* YUV4MPEG2, converted to I420 (BT.601, limited range). Frame size is fixed by the first frame. */
+#define SGL_RECORD_RAW 1 /* Raw RGBA frames, top row first. */
+
+/* Frames are dropped if the queue is full. The render thread never waits. */
+#define SGL_RECORD_DROP 0
+/* sgl_swap_buffers() waits for the writer to free a queue entry. Frames are only lost if readback falls behind. */
+#define SGL_RECORD_WAIT 1
+
+struct sgl_record_options
+{
+   /* SGL_RECORD_Y4M or SGL_RECORD_RAW. */
+   int container;
+   /* SGL_RECORD_DROP or SGL_RECORD_WAIT. */
+   int policy;
+   /* Frames the queue can hold. 0 = default (8). */
+   unsigned queue_size;
+   /* Frame rate written to Y4M headers, as fps_num / fps_den. 0 = display refresh rate, or 60. */
+   unsigned fps_num;
+   unsigned fps_den;
+};
+
+struct sgl_record_stats
+{
+   uint64_t written;
+   /* Frames lost to a full queue, readback falling behind, or write errors. */
+   uint64_t dropped;
+   /* Frames waiting for the writer. */
+   unsigned queued;
+};
+
+/* opts may be NULL for defaults. Starts frame capture if it isn't running. */
+int sgl_start_recording(const char *path, const struct sgl_record_options *opts);
+/* Waits for queued frames to be written. */
+void sgl_stop_recording(void);
+int sgl_get_record_stats(struct sgl_record_stats *stats);
+
+/* Input recording and replay. Every main window event delivered to callbacks or sgl_poll_events()
+ * is appended to a compact binary log, written by a background thread. (X11 only.)
+ * A replayed log is delivered in place of live input, which is ignored until the replay ends. */
+/* Events are delivered on the same sgl_is_alive()/sgl_poll_events() call, counted from the start of the replay. */
+#define SGL_REPLAY_FRAME_LOCKED 0
+/* Events are delivered once as much time has passed as when they were recorded. */
+#define SGL_REPLAY_TIME_LOCKED 1
+
+int sgl_start_input_recording(const char *path);
+/* Waits for the log to be written. */
+void sgl_stop_input_recording(void);
+/* Reads the whole log up front. mode is SGL_REPLAY_FRAME_LOCKED or SGL_REPLAY_TIME_LOCKED. */
+int sgl_start_input_replay(const char *path, int mode);
+/* Returns 1 until the last event of the log has been delivered or the replay is stopped. */
+int sgl_is_replaying(void);
+void sgl_stop_input_replay(void);
+
+/* Focus state as of the last call to sgl_is_alive(). Headless contexts always have focus. */
 int sgl_has_focus(void);
 
 /* When this returns 0, the window or application was killed (SIGINT/SIGTERM). */ 
 int sgl_is_alive(void);
 
+/* Frame loop profiling. Only available if SGL is built with SGL_PROFILE defined.
+ * Set SGL_PROFILE in the environment to dump the profile to stderr at the end of sgl_deinit().
+ * With SGL_PROFILE=json, it is dumped as a single line JSON object for scripts to compare. */
+#define SGL_PROFILE_PUMP 0     /* Event pumping in sgl_is_alive() and sgl_poll_events(). */
+#define SGL_PROFILE_DISPATCH 1 /* Input callback dispatch in sgl_is_alive(). */
+#define SGL_PROFILE_RESIZE 2   /* sgl_check_resize(). */
+#define SGL_PROFILE_SWAP 3     /* Time spent in sgl_swap_buffers(). */
+#define SGL_PROFILE_INIT 4     /* sgl_init(). */
+#define SGL_PROFILE_DEINIT 5   /* sgl_deinit(). */
+/* Input latency per event type, from the window system timestamping an event until it is passed
+ * to an input callback or returned by sgl_poll_events(). Event timestamps have millisecond resolution,
+ * so values below a few milliseconds are mostly rounding. On X11 this assumes a local server using
+ * CLOCK_MONOTONIC, as Xorg and Xvfb do, and is meaningless otherwise. It is recorded passively in
+ * real frame loops. bench/latency.c measures send to callback with XTest on a single clock instead. */
+#define SGL_PROFILE_KEY_LATENCY 6
+#define SGL_PROFILE_MOUSE_MOVE_LATENCY 7
+#define SGL_PROFILE_MOUSE_BUTTON_LATENCY 8
+#define SGL_PROFILE_PHASES 9
+
+struct sgl_profile_phase
+{
+   uint64_t count;
+   /* Times in nanoseconds. Percentiles are accurate to within 6.25%. */
+   uint64_t total;
+   uint64_t min;
+   uint64_t max;
+   uint64_t p50;
+   uint64_t p95;
+   uint64_t p99;
+};
+
+struct sgl_profile
+{
+   struct sgl_profile_phase phases[SGL_PROFILE_PHASES];
+};
+
+/* Returns SGL_ERROR if profiling was compiled out. Safe to call from any thread. */
+int sgl_get_profile(struct sgl_profile *profile);
+
 /* Get underlying platform specific window handles. Use it to implement input. */
 void sgl_get_handles(struct sgl_handles *handles);
 
+/* Contexts sharing textures, buffers and shaders with the main context, so resources can be
+ * uploaded and compiled on other threads. Needs context.shared in sgl_init(). (X11 only.)
+ * They are never presented. Workers get a 1x1 pbuffer, or no drawable where the platform allows.
+ * Shared contexts must be destroyed before sgl_deinit(). */
+struct sgl_shared_context;
+
+struct sgl_shared_context *sgl_create_shared_context(void);
+/* Makes ctx current on the calling thread. NULL releases the calling thread's context. */
+int sgl_make_current_shared(struct sgl_shared_context *ctx);
+void sgl_destroy_shared_context(struct sgl_shared_context *ctx);
+
+/* Fences for synchronizing between contexts. Need OpenGL 3.2, ARB_sync or OpenGL ES 3.0. */
+struct sgl_fence;
+
+/* Inserts a fence after the commands issued so far in the current context and flushes them,
+ * so other contexts can wait on it. Returns NULL if fences are not supported. */
+struct sgl_fence *sgl_fence_insert(void);
+/* Makes later commands in the current context wait for the fence on the GPU. Returns immediately. */
+void sgl_fence_wait_gpu(struct sgl_fence *fence);
+/* Blocks until the fence signals or timeout nanoseconds pass. Returns SGL_TRUE if it signaled. */
+int sgl_fence_wait(struct sgl_fence *fence, uint64_t timeout);
+void sgl_fence_delete(struct sgl_fence *fence);
+
 /* GetProcAddress() wrapper. */
 typedef void (*sgl_function_t)(void);
 sgl_function_t sgl_get_proc_address(const char *sym);
 
+/* Entry points named in sgl_context_options::gl.procs, in the same order, resolved once when
+ * the context current on the calling thread was created. Entries are NULL where unavailable.
+ * No other entry points, core or extension, are in the table.
+ * Returns NULL if no SGL context is current on this thread or no entry points were requested. */
+const sgl_function_t *sgl_get_dispatch_table(void);
+
+/* Checks for a GL or window system (GLX, EGL, WGL) extension of the main context
+ * with a hash lookup. Valid between sgl_init() and sgl_deinit(). */
+int sgl_has_extension(const char *name);
+
 /* Input callbacks. If non-NULL a callback may be called one or more times in calls to sgl_is_alive().
  * Coordinates for mouse are absolute with respect to the window. */
 typedef void (*sgl_key_callback_t)(int key, int pressed);
 typedef void (*sgl_mouse_move_callback_t)(int x, int y);
 typedef void (*sgl_mouse_button_callback_t)(int button, int pressed, int x, int y);
+/* Called when the window gains or loses focus. */
+typedef void (*sgl_focus_callback_t)(int focused);
 struct sgl_input_callbacks
 {
    sgl_key_callback_t key_cb;
    sgl_mouse_move_callback_t mouse_move_cb;
    sgl_mouse_button_callback_t mouse_button_cb;
+   sgl_focus_callback_t focus_cb;
 };
 
 void sgl_set_input_callbacks(const struct sgl_input_callbacks *cbs);
+
+/* Batched input. Events are queued by sgl_is_alive() and sgl_poll_events().
+ * Events with a matching input callback are dispatched by sgl_is_alive(),
+ * all others stay queued until drained by sgl_poll_events(). */
+#define SGL_EVENT_KEY 1
+#define SGL_EVENT_MOUSE_MOVE 2
+#define SGL_EVENT_MOUSE_BUTTON 3
+#define SGL_EVENT_FOCUS 4
+#define SGL_EVENT_MASK(type) (1u << (type))
+
+struct sgl_event
+{
+   /* SGL_EVENT_* */
+   unsigned short type;
+   /* Non-zero if key or button was pressed, or if window gained focus. */
+   unsigned short pressed;
+   /* SGLK_* for keys, button index for mouse buttons. */
+   int code;
+   /* Mouse coordinates. Deltas if mouse is in relative mode. */
+   int x, y;
+   /* Timestamp in milliseconds. Only meaningful relative to other events. */
+   unsigned timestamp;
+   /* Window created with sgl_window_create() the event belongs to. NULL for the main window. */
+   struct sgl_window *window;
+};
+
+/* Additional windows. They are created next to the main window from sgl_init() and share its
+ * display connection and context, so GL objects are shared between all windows.
+ * Their events are read by sgl_is_alive() and sgl_poll_events() along with the main window's.
+ * Each window has its own input callbacks, size and focus. Closing one does not end sgl_is_alive().
+ * Frame timing, present modes, capture, fullscreen and mouse grabs are main window only. (X11 only.)
+ * Functions taking a window use the main window when passed NULL. */
+struct sgl_window;
+
+struct sgl_window_options
+{
+   /* Window size. monitor_index is ignored. */
+   struct sgl_resolution res;
+   const char *title;
+};
+
+struct sgl_window *sgl_window_create(const struct sgl_window_options *opts);
+void sgl_window_destroy(struct sgl_window *win);
+/* Renders to win from the calling thread. Swaps of other windows don't wait for vblank,
+ * so draw and swap them before the main window. */
+int sgl_window_make_current(struct sgl_window *win);
+/* win must be current. */
+void sgl_window_swap_buffers(struct sgl_window *win);
+int sgl_window_check_resize(struct sgl_window *win, unsigned *width, unsigned *height);
+void sgl_window_set_title(struct sgl_window *win, const char *title);
+void sgl_window_set_input_callbacks(struct sgl_window *win, const struct sgl_input_callbacks *cbs);
+int sgl_window_has_focus(struct sgl_window *win);
+/* Returns 0 once the window was closed. It stays valid until sgl_window_destroy(). */
+int sgl_window_is_open(struct sgl_window *win);
+
+/* Select which event types should be queued for sgl_poll_events(). Mask of SGL_EVENT_MASK(type). */
+void sgl_set_event_mask(unsigned mask);
+
+/* Fill in up to max_events queued events. Returns number of events written. */
+unsigned sgl_poll_events(struct sgl_event *events, unsigned max_events);
+
+struct sgl_input_queue_stats
+{
+   /* Number of events the queue can hold. */
+   unsigned capacity;
+   /* Events currently waiting in the queue. */
+   unsigned fill;
+   /* Highest number of events ever waiting in the queue. */
+   unsigned high_water;
+   /* Events dropped because the queue was full. */
+   unsigned long long dropped;
+};
+
+/* Get statistics for the threaded input queue. Returns SGL_ERROR if threaded input is not in use. */
+int sgl_get_input_queue_stats(struct sgl_input_queue_stats *stats);
+
+/* Event coalescing. Consecutive queued events of one type for the same window are merged before
+ * they are dispatched or returned by sgl_poll_events(), e.g. to get one mouse move per frame
+ * from a high polling rate mouse. Keys and buttons only merge with identical events. (X11 only.) */
+#define SGL_COALESCE_NONE 0       /* Keep every event. Default. */
+#define SGL_COALESCE_LAST 1       /* Keep the latest. */
+/* Relative mouse moves: sum x and y. Absolute mouse moves and others: as SGL_COALESCE_LAST. */
+#define SGL_COALESCE_ACCUMULATE 2
+int sgl_set_event_coalescing(int type, int policy);
+
+/* If enabled, key presses generated by autorepeat are dropped, so holding a key gives one press
+ * and one release. Uses XKB detectable autorepeat. Returns SGL_ERROR if unsupported. (X11 only.) */
+int sgl_set_key_repeat_filter(int enable);
+
+struct sgl_input_filter_stats
+{
+   /* Events merged into an earlier one, indexed by SGL_EVENT_*. */
+   unsigned long long merged[SGL_EVENT_FOCUS + 1];
+   /* Autorepeat key presses dropped. */
+   unsigned long long repeats_dropped;
+};
+int sgl_get_input_filter_stats(struct sgl_input_filter_stats *stats);
+
+/* In relative mode, mouse move events carry deltas. If SGL is built with SGL_HAVE_XINPUT2
+ * (X11, link with -lXi) and the server has XInput 2, they are unaccelerated device deltas
+ * from raw motion events and the pointer is never warped. Otherwise they are derived from
+ * pointer positions, and a captured pointer is warped back to the window center every frame. */
 void sgl_set_mouse_mode(int capture, int relative, int visible);
 
 #ifdef __cplusplus
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Capability cache. Included by the POSIX backends.
+// Remembers what context creation settled on for a display, driver and set of options,
+// so later runs can skip config matching, the context version fallback chain and extension probing.
+//
+// The file is text: a "SGLCAPS <version>" line, then one entry per line:
+//    <key> <renderer> <major> <minor> <fbconfig id> <caps>
+// key and renderer are FNV-1a hashes in hex. Entries are only trusted if the renderer,
+// which is only known once a context exists, matches again afterwards.
+// The path is $SGL_CAPS_CACHE if set (empty disables the cache), else $XDG_CACHE_HOME/sgl-caps
+// or ~/.cache/sgl-caps.
+
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CAPS_VERSION 1
+#define CAPS_MAX_ENTRIES 32
+
+#define CAPS_SWAP_SGI  (1 << 0)
+#define CAPS_SWAP_MESA (1 << 1)
+#define CAPS_SWAP_EXT  (1 << 2)
+#define CAPS_SWAP_TEAR (1 << 3)
+
+struct caps_entry
+{
+   uint32_t key;
+   uint32_t renderer;
+   unsigned major;
+   unsigned minor;
+   int fbconfig_id;
+   unsigned caps;
+};
+
+static uint32_t caps_hash(uint32_t hash, const char *str)
+{
+   if (!str)
+      str = "";
+
+   // Strings are separated, so "ab" + "c" and "a" + "bc" differ.
+   for (; *str; str++)
+      hash = (hash ^ (uint8_t)*str) * 16777619u;
+   return (hash ^ 0xff) * 16777619u;
+}
+
+static uint32_t caps_hash_uint(uint32_t hash, unsigned v)
+{
+   char buf[16];
+   snprintf(buf, sizeof(buf), "%u", v);
+   return caps_hash(hash, buf);
+}
+
+static bool caps_path(char *path, size_t size)
+{
+   const char *env = getenv("SGL_CAPS_CACHE");
+   if (env)
+   {
+      if (!*env)
+         return false;
+      snprintf(path, size, "%s", env);
+      return true;
+   }
+
+   env = getenv("XDG_CACHE_HOME");
+   if (env && *env)
+   {
+      snprintf(path, size, "%s/sgl-caps", env);
+      return true;
+   }
+
+   env = getenv("HOME");
+   if (!env || !*env)
+      return false;
+
+   snprintf(path, size, "%s/.cache", env);
+   mkdir(path, 0700);
+   snprintf(path, size, "%s/.cache/sgl-caps", env);
+   return true;
+}
+
+// Reads every entry of the cache file. Returns the number of entries.
+static unsigned caps_read(const char *path, struct caps_entry *entries, unsigned max_entries)
+{
+   FILE *file = fopen(path, "r");
+   if (!file)
+      return 0;
+
+   unsigned version = 0, num = 0;
+   if (fscanf(file, "SGLCAPS %u", &version) != 1 || version != CAPS_VERSION)
+   {
+      fclose(file);
+      return 0;
+   }
+
+   struct caps_entry entry;
+   while (num < max_entries && fscanf(file, "%" SCNx32 " %" SCNx32 " %u %u %d %x",
+            &entry.key, &entry.renderer, &entry.major, &entry.minor,
+            &entry.fbconfig_id, &entry.caps) == 6)
+      entries[num++] = entry;
+
+   fclose(file);
+   return num;
+}
+
+// Finds the entry for key. *out is zeroed when there is none.
+static bool caps_load(uint32_t key, struct caps_entry *out)
+{
+   memset(out, 0, sizeof(*out));
+
+   char path[PATH_MAX];
+   if (!caps_path(path, sizeof(path)))
+      return false;
+
+   struct caps_entry entries[CAPS_MAX_ENTRIES];
+   unsigned num = caps_read(path, entries, CAPS_MAX_ENTRIES);
+   for (unsigned i = 0; i < num; i++)
+   {
+      if (entries[i].key == key)
+      {
+         *out = entries[i];
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// Replaces or adds the entry for entry->key. The newest entry goes first, and
+// the oldest ones are dropped beyond CAPS_MAX_ENTRIES. The file is replaced atomically,
+// so concurrent processes see either the old or the new cache.
+static void caps_store(const struct caps_entry *entry)
+{
+   char path[PATH_MAX], tmp_path[PATH_MAX + 32];
+   if (!caps_path(path, sizeof(path)))
+      return;
+
+   struct caps_entry entries[CAPS_MAX_ENTRIES];
+   unsigned num = caps_read(path, entries, CAPS_MAX_ENTRIES);
+
+   snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", path, (long)getpid());
+   FILE *file = fopen(tmp_path, "w");
+   if (!file)
+      return;
+
+   fprintf(file, "SGLCAPS %u\n", CAPS_VERSION);
+   fprintf(file, "%08" PRIx32 " %08" PRIx32 " %u %u %d %x\n", entry->key, entry->renderer,
+         entry->major, entry->minor, entry->fbconfig_id, entry->caps);
+
+   unsigned written = 1;
+   for (unsigned i = 0; i < num && written < CAPS_MAX_ENTRIES; i++)
+   {
+      if (entries[i].key == entry->key)
+         continue;
+
+      fprintf(file, "%08" PRIx32 " %08" PRIx32 " %u %u %d %x\n", entries[i].key, entries[i].renderer,
+            entries[i].major, entries[i].minor, entries[i].fbconfig_id, entries[i].caps);
+      written++;
+   }
+
+   if (fclose(file) != 0 || rename(tmp_path, path) != 0)
+      unlink(tmp_path);
+}
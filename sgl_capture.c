@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Asynchronous frame capture. Included by the platform backends, which call
+ * capture_frame() and capture_pump() from sgl_swap_buffers() before presenting.
+ *
+ * Each swap reads the frame into the next pixel buffer object of a ring and puts a fence
+ * after it. Frames are mapped once their fence has signalled, so neither side waits on the GPU.
+ * If every buffer is still in flight, the frame is dropped rather than stalling.
+ *
+ * Other modules (e.g. frame export) register sinks, which get every retrieved frame
+ * straight from the mapped buffer and convert it into their own memory.
+ * The ring stays up as long as the application or any sink still uses it. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sgl_pixel.c"
+
+#define CAPTURE_DEFAULT_DEPTH 3
+
+struct capture_slot
+{
+   GLuint pbo;
+   GLsync fence;
+   size_t size;
+   unsigned width;
+   unsigned height;
+   uint64_t sbc;
+   int64_t cpu_swap_begin;
+};
+
+/* A mapped frame in read format, bottom row first. */
+struct capture_source
+{
+   const uint8_t *data;
+   unsigned width;
+   unsigned height;
+   unsigned stride;
+   uint64_t sbc;
+   int64_t cpu_swap_begin;
+};
+
+typedef void (*capture_sink_t)(const struct capture_source *src);
+
+#define CAPTURE_MAX_SINKS 4
+static capture_sink_t g_capture_sinks[CAPTURE_MAX_SINKS];
+
+static struct
+{
+   int active;
+   /* Started by sgl_start_capture() rather than only for sinks. */
+   int started;
+   int format;
+   int flip;
+   /* Frames are swizzled on the CPU if read_format differs from the requested format. */
+   GLenum read_format;
+
+   unsigned depth;
+   unsigned head;
+   unsigned tail;
+   unsigned pending;
+   uint64_t dropped;
+   struct capture_slot slots[SGL_CAPTURE_MAX_DEPTH];
+
+   uint8_t *frame;
+   size_t frame_size;
+
+   PFNGLGENBUFFERSPROC pglGenBuffers;
+   PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+   PFNGLBINDBUFFERPROC pglBindBuffer;
+   PFNGLBUFFERDATAPROC pglBufferData;
+   PFNGLMAPBUFFERRANGEPROC pglMapBufferRange;
+   PFNGLMAPBUFFERPROC pglMapBuffer;
+   PFNGLUNMAPBUFFERPROC pglUnmapBuffer;
+   PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer;
+   PFNGLFENCESYNCPROC pglFenceSync;
+   PFNGLCLIENTWAITSYNCPROC pglClientWaitSync;
+   PFNGLDELETESYNCPROC pglDeleteSync;
+} g_capture;
+
+static int capture_load_procs(void)
+{
+   g_capture.pglGenBuffers      = (PFNGLGENBUFFERSPROC)sgl_get_proc_address("glGenBuffers");
+   g_capture.pglDeleteBuffers   = (PFNGLDELETEBUFFERSPROC)sgl_get_proc_address("glDeleteBuffers");
+   g_capture.pglBindBuffer      = (PFNGLBINDBUFFERPROC)sgl_get_proc_address("glBindBuffer");
+   g_capture.pglBufferData      = (PFNGLBUFFERDATAPROC)sgl_get_proc_address("glBufferData");
+   g_capture.pglMapBufferRange  = (PFNGLMAPBUFFERRANGEPROC)sgl_get_proc_address("glMapBufferRange");
+   g_capture.pglMapBuffer       = (PFNGLMAPBUFFERPROC)sgl_get_proc_address("glMapBuffer");
+   g_capture.pglUnmapBuffer     = (PFNGLUNMAPBUFFERPROC)sgl_get_proc_address("glUnmapBuffer");
+   g_capture.pglBindFramebuffer = (PFNGLBINDFRAMEBUFFERPROC)sgl_get_proc_address("glBindFramebuffer");
+   g_capture.pglFenceSync       = (PFNGLFENCESYNCPROC)sgl_get_proc_address("glFenceSync");
+   g_capture.pglClientWaitSync  = (PFNGLCLIENTWAITSYNCPROC)sgl_get_proc_address("glClientWaitSync");
+   g_capture.pglDeleteSync      = (PFNGLDELETESYNCPROC)sgl_get_proc_address("glDeleteSync");
+
+   /* Without sync objects, a frame is assumed done once the ring has filled up behind it. */
+   if (!g_capture.pglClientWaitSync || !g_capture.pglDeleteSync)
+      g_capture.pglFenceSync = NULL;
+
+   return g_capture.pglGenBuffers && g_capture.pglDeleteBuffers && g_capture.pglBindBuffer &&
+      g_capture.pglBufferData && g_capture.pglUnmapBuffer &&
+      (g_capture.pglMapBufferRange || g_capture.pglMapBuffer);
+}
+
+static void capture_stop(void);
+
+static int capture_start(const struct sgl_capture_options *opts)
+{
+   unsigned i;
+   GLuint pbos[SGL_CAPTURE_MAX_DEPTH];
+   const char *version;
+   int gles;
+
+   capture_stop();
+
+   if (!capture_load_procs())
+   {
+      fprintf(stderr, "[SGL]: Frame capture needs pixel buffer objects.\n");
+      return SGL_ERROR;
+   }
+
+   /* BGRA is the fast readback path on desktop GL, but GLES only guarantees RGBA. */
+   version = (const char*)glGetString(GL_VERSION);
+   gles = version && strncmp(version, "OpenGL ES", 9) == 0;
+
+   g_capture.format = opts->format;
+   g_capture.flip = opts->flip;
+   g_capture.read_format = gles || opts->format == SGL_PIXEL_FORMAT_RGBA ? GL_RGBA : GL_BGRA;
+
+   g_capture.depth = opts->depth ? opts->depth : CAPTURE_DEFAULT_DEPTH;
+   if (g_capture.depth > SGL_CAPTURE_MAX_DEPTH)
+      g_capture.depth = SGL_CAPTURE_MAX_DEPTH;
+
+   g_capture.pglGenBuffers(g_capture.depth, pbos);
+   for (i = 0; i < g_capture.depth; i++)
+      g_capture.slots[i].pbo = pbos[i];
+
+   g_capture.active = 1;
+   return SGL_OK;
+}
+
+static void capture_release_slot(struct capture_slot *slot)
+{
+   if (slot->fence)
+   {
+      g_capture.pglDeleteSync(slot->fence);
+      slot->fence = NULL;
+   }
+
+   g_capture.tail = (g_capture.tail + 1) % g_capture.depth;
+   g_capture.pending--;
+}
+
+static void capture_stop(void)
+{
+   unsigned i;
+   if (!g_capture.active)
+      return;
+
+   while (g_capture.pending)
+      capture_release_slot(&g_capture.slots[g_capture.tail]);
+
+   for (i = 0; i < g_capture.depth; i++)
+      g_capture.pglDeleteBuffers(1, &g_capture.slots[i].pbo);
+
+   free(g_capture.frame);
+   memset(&g_capture, 0, sizeof(g_capture));
+}
+
+static void capture_frame(unsigned width, unsigned height, uint64_t sbc, int64_t cpu_swap_begin)
+{
+   struct capture_slot *slot;
+   GLint old_pbo = 0, old_fbo = 0, old_alignment = 4;
+   size_t size = (size_t)width * height * 4;
+
+   if (!g_capture.active || !width || !height)
+      return;
+
+   if (g_capture.pending == g_capture.depth)
+   {
+      g_capture.dropped++;
+      return;
+   }
+
+   slot = &g_capture.slots[g_capture.head];
+   slot->width = width;
+   slot->height = height;
+   slot->sbc = sbc;
+   slot->cpu_swap_begin = cpu_swap_begin;
+
+   glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &old_pbo);
+   glGetIntegerv(GL_PACK_ALIGNMENT, &old_alignment);
+   if (g_capture.pglBindFramebuffer)
+   {
+      glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &old_fbo);
+      g_capture.pglBindFramebuffer(GL_READ_FRAMEBUFFER, sgl_get_framebuffer());
+   }
+
+   g_capture.pglBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+   if (slot->size != size)
+   {
+      g_capture.pglBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+      slot->size = size;
+   }
+
+   glPixelStorei(GL_PACK_ALIGNMENT, 4);
+   glReadPixels(0, 0, width, height, g_capture.read_format, GL_UNSIGNED_BYTE, NULL);
+   if (g_capture.pglFenceSync)
+      slot->fence = g_capture.pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+   glPixelStorei(GL_PACK_ALIGNMENT, old_alignment);
+   g_capture.pglBindBuffer(GL_PIXEL_PACK_BUFFER, old_pbo);
+   if (g_capture.pglBindFramebuffer)
+      g_capture.pglBindFramebuffer(GL_READ_FRAMEBUFFER, old_fbo);
+
+   g_capture.head = (g_capture.head + 1) % g_capture.depth;
+   g_capture.pending++;
+}
+
+static int capture_slot_ready(const struct capture_slot *slot)
+{
+   GLenum ret;
+   if (!slot->fence)
+      return g_capture.pending == g_capture.depth;
+
+   ret = g_capture.pglClientWaitSync(slot->fence, 0, 0);
+   return ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED;
+}
+
+static int capture_has_sinks(void)
+{
+   unsigned i;
+   for (i = 0; i < CAPTURE_MAX_SINKS; i++)
+   {
+      if (g_capture_sinks[i])
+         return 1;
+   }
+   return 0;
+}
+
+int sgl_start_capture(const struct sgl_capture_options *opts)
+{
+   if (!capture_start(opts))
+      return SGL_ERROR;
+
+   g_capture.started = 1;
+   return SGL_OK;
+}
+
+/* Sinks registered by other modules keep the ring running. */
+void sgl_stop_capture(void)
+{
+   g_capture.started = 0;
+   if (!capture_has_sinks())
+      capture_stop();
+}
+
+/* Starts capture with opts if nothing else is using it. */
+static int capture_add_sink(capture_sink_t sink, const struct sgl_capture_options *opts)
+{
+   unsigned i;
+
+   if (!g_capture.active && !capture_start(opts))
+      return 0;
+
+   for (i = 0; i < CAPTURE_MAX_SINKS; i++)
+   {
+      if (!g_capture_sinks[i])
+      {
+         g_capture_sinks[i] = sink;
+         return 1;
+      }
+   }
+
+   if (!g_capture.started && !capture_has_sinks())
+      capture_stop();
+   return 0;
+}
+
+/* Stops capture once the last user is gone. */
+static void capture_remove_sink(capture_sink_t sink)
+{
+   unsigned i;
+   for (i = 0; i < CAPTURE_MAX_SINKS; i++)
+   {
+      if (g_capture_sinks[i] == sink)
+         g_capture_sinks[i] = NULL;
+   }
+
+   if (!g_capture.started && !capture_has_sinks())
+      capture_stop();
+}
+
+/* Converts a mapped frame to a SGL_PIXEL_FORMAT_*, top row first if flip is set. */
+static void capture_convert(uint8_t *dst, unsigned dst_stride,
+      const struct capture_source *src, int format, int flip)
+{
+   GLenum gl_format = format == SGL_PIXEL_FORMAT_RGBA ? GL_RGBA : GL_BGRA;
+   pixel_copy_image(dst, dst_stride, src->data, src->stride,
+         src->width, src->height, gl_format != g_capture.read_format, flip);
+}
+
+/* Maps the oldest frame if it is done, hands it to the sinks,
+ * and converts it for the caller if frame is non-NULL. */
+static int capture_retrieve(struct sgl_captured_frame *frame)
+{
+   unsigned i;
+   struct capture_slot *slot;
+   struct capture_source source;
+   const uint8_t *src;
+   GLint old_pbo = 0;
+
+   if (!g_capture.active || !g_capture.pending)
+      return SGL_FALSE;
+
+   slot = &g_capture.slots[g_capture.tail];
+   if (!capture_slot_ready(slot))
+      return SGL_FALSE;
+
+   if (frame && g_capture.frame_size < slot->size)
+   {
+      uint8_t *buf = (uint8_t*)realloc(g_capture.frame, slot->size);
+      if (!buf)
+         return SGL_FALSE;
+      g_capture.frame = buf;
+      g_capture.frame_size = slot->size;
+   }
+
+   glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &old_pbo);
+   g_capture.pglBindBuffer(GL_PIXEL_PACK_BUFFER, slot->pbo);
+
+   if (g_capture.pglMapBufferRange)
+      src = (const uint8_t*)g_capture.pglMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot->size, GL_MAP_READ_BIT);
+   else
+      src = (const uint8_t*)g_capture.pglMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+
+   if (src)
+   {
+      source.data           = src;
+      source.width          = slot->width;
+      source.height         = slot->height;
+      source.stride         = slot->width * 4;
+      source.sbc            = slot->sbc;
+      source.cpu_swap_begin = slot->cpu_swap_begin;
+
+      for (i = 0; i < CAPTURE_MAX_SINKS; i++)
+      {
+         if (g_capture_sinks[i])
+            g_capture_sinks[i](&source);
+      }
+
+      if (frame)
+      {
+         capture_convert(g_capture.frame, source.stride, &source, g_capture.format, g_capture.flip);
+
+         frame->data           = g_capture.frame;
+         frame->width          = source.width;
+         frame->height         = source.height;
+         frame->stride         = source.stride;
+         frame->format         = g_capture.format;
+         frame->sbc            = source.sbc;
+         frame->cpu_swap_begin = source.cpu_swap_begin;
+         frame->dropped        = g_capture.dropped;
+      }
+
+      g_capture.pglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+   }
+
+   g_capture.pglBindBuffer(GL_PIXEL_PACK_BUFFER, old_pbo);
+   capture_release_slot(slot);
+   return src ? SGL_TRUE : SGL_FALSE;
+}
+
+int sgl_get_captured_frame(struct sgl_captured_frame *frame)
+{
+   return capture_retrieve(frame);
+}
+
+/* With sinks registered, finished frames are retrieved at every swap
+ * instead of waiting for sgl_get_captured_frame(). */
+static void capture_pump(void)
+{
+   unsigned i;
+   for (i = 0; i < CAPTURE_MAX_SINKS; i++)
+   {
+      if (g_capture_sinks[i])
+         break;
+   }
+
+   if (i == CAPTURE_MAX_SINKS)
+      return;
+
+   while (capture_retrieve(NULL))
+      ;
+}
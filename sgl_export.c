@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Shared memory frame export. Included by the POSIX backends after sgl_capture.c.
+// Frames are converted straight from the mapped pixel buffer into the shared ring,
+// so publishing costs one copy and consumers can read with one more.
+
+#include "sgl_export.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define EXPORT_DEFAULT_SLOTS 3
+#define EXPORT_ALIGN(x, align) (((x) + (align) - 1) & ~((size_t)(align) - 1))
+
+static struct
+{
+   char *name;
+   int format;
+   struct sgl_export_header *header;
+   size_t size;
+   uint64_t seq;
+} g_export;
+
+static int64_t export_time_usec(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return (int64_t)tv.tv_sec * 1000000 + tv.tv_nsec / 1000;
+}
+
+static void export_frame(const struct capture_source *src)
+{
+   struct sgl_export_header *header = g_export.header;
+   unsigned stride = src->width * 4;
+
+   if ((size_t)stride * src->height > header->max_frame_size)
+   {
+      __atomic_add_fetch(&header->dropped, 1, __ATOMIC_RELAXED);
+      return;
+   }
+
+   uint64_t seq = ++g_export.seq;
+   struct sgl_export_frame *frame = (struct sgl_export_frame*)((uint8_t*)header +
+         header->header_size + (size_t)((seq - 1) % header->num_slots) * header->slot_size);
+
+   // Mark the slot as being written before touching its contents.
+   __atomic_store_n(&frame->seq, 0, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+
+   frame->sbc            = src->sbc;
+   frame->cpu_swap_begin = src->cpu_swap_begin;
+   frame->width          = src->width;
+   frame->height         = src->height;
+   frame->stride         = stride;
+   frame->format         = g_export.format;
+   capture_convert((uint8_t*)frame + frame->data_offset, stride, src, g_export.format, true);
+   frame->publish_time   = export_time_usec();
+
+   __atomic_store_n(&frame->seq, seq, __ATOMIC_RELEASE);
+
+   // Sequentially consistent with the consumer bumping waiters before FUTEX_WAIT,
+   // so either we see the waiter or the waiter sees the new seq.
+   __atomic_store_n(&header->seq, (uint32_t)seq, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+   if (__atomic_load_n(&header->waiters, __ATOMIC_SEQ_CST))
+      syscall(SYS_futex, &header->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+int sgl_start_export(const struct sgl_export_options *opts)
+{
+   sgl_stop_export();
+
+   if (!opts->name)
+      return SGL_ERROR;
+
+   unsigned width = opts->max_width ? opts->max_width : (unsigned)g_last_width;
+   unsigned height = opts->max_height ? opts->max_height : (unsigned)g_last_height;
+   unsigned num_slots = opts->num_slots ? opts->num_slots : EXPORT_DEFAULT_SLOTS;
+
+   size_t max_frame_size = (size_t)width * height * 4;
+   size_t header_size = EXPORT_ALIGN(sizeof(struct sgl_export_header), 64);
+   size_t data_offset = EXPORT_ALIGN(sizeof(struct sgl_export_frame), 64);
+   size_t slot_size = EXPORT_ALIGN(data_offset + max_frame_size, 4096);
+   if (max_frame_size > UINT32_MAX || slot_size > UINT32_MAX)
+      return SGL_ERROR;
+
+   g_export.size = header_size + num_slots * slot_size;
+
+   int fd = shm_open(opts->name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (fd < 0)
+   {
+      fprintf(stderr, "[SGL]: Failed to open shared memory object %s.\n", opts->name);
+      return SGL_ERROR;
+   }
+
+   void *ptr = MAP_FAILED;
+   if (ftruncate(fd, g_export.size) == 0)
+      ptr = mmap(NULL, g_export.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (ptr == MAP_FAILED)
+   {
+      fprintf(stderr, "[SGL]: Failed to map shared memory object %s.\n", opts->name);
+      shm_unlink(opts->name);
+      return SGL_ERROR;
+   }
+
+   g_export.header = ptr;
+   g_export.name = strdup(opts->name);
+   g_export.format = opts->format;
+   g_export.seq = 0;
+
+   struct sgl_export_header *header = g_export.header;
+   header->version        = SGL_EXPORT_VERSION;
+   header->header_size    = header_size;
+   header->num_slots      = num_slots;
+   header->slot_size      = slot_size;
+   header->max_frame_size = max_frame_size;
+
+   for (unsigned i = 0; i < num_slots; i++)
+   {
+      struct sgl_export_frame *frame = (struct sgl_export_frame*)((uint8_t*)header + header_size + i * slot_size);
+      frame->data_offset = data_offset;
+   }
+
+   // Consumers may map the object early. Magic goes last so they can wait for it.
+   __atomic_store_n(&header->magic, SGL_EXPORT_MAGIC, __ATOMIC_RELEASE);
+
+   const struct sgl_capture_options capture_opts = {
+      .format = opts->format,
+   };
+
+   if (!capture_add_sink(export_frame, &capture_opts))
+   {
+      sgl_stop_export();
+      return SGL_ERROR;
+   }
+   return SGL_OK;
+}
+
+void sgl_stop_export(void)
+{
+   capture_remove_sink(export_frame);
+
+   if (g_export.header)
+      munmap(g_export.header, g_export.size);
+
+   if (g_export.name)
+   {
+      shm_unlink(g_export.name);
+      free(g_export.name);
+   }
+
+   memset(&g_export, 0, sizeof(g_export));
+}
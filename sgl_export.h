@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef SGL_EXPORT_H__
+#define SGL_EXPORT_H__
+
+/* Layout of the shared memory frame ring written by sgl_start_export().
+ * Consumers only need this header, not SGL itself.
+ *
+ * The object is a sgl_export_header followed by num_slots slots.
+ * Slot i starts at header_size + i * slot_size and holds a sgl_export_frame
+ * with the pixel data data_offset bytes into the slot.
+ * Frame number seq (starting at 1) is written to slot (seq - 1) % num_slots.
+ *
+ * Publishing a frame:
+ *  - The producer stores 0 to the slot's seq, writes the frame and then stores seq (release).
+ *  - It then stores the low 32 bits of seq to the header's seq (release).
+ *  - If waiters is non-zero, it wakes them with FUTEX_WAKE on the header's seq.
+ *
+ * Reading a frame:
+ *  - Wait until the header's seq changes. To block, increment waiters,
+ *    FUTEX_WAIT on seq with the last value seen, then decrement waiters.
+ *  - Load the slot's seq (acquire) and skip the slot if it isn't the wanted frame.
+ *  - Copy the frame out, then load the slot's seq again (after an acquire fence).
+ *    If it changed, the producer overwrote the slot while it was copied and the copy is torn. */
+
+#include <stdint.h>
+
+#define SGL_EXPORT_MAGIC 0x58474c53u /* "SGLX" */
+#define SGL_EXPORT_VERSION 1
+
+struct sgl_export_header
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t header_size;
+   uint32_t num_slots;
+   uint32_t slot_size;
+   /* Largest frame in bytes a slot can hold. Larger frames are not exported. */
+   uint32_t max_frame_size;
+
+   /* Futex word. Low 32 bits of the last published frame number. 0 before the first frame. */
+   uint32_t seq;
+   /* Number of consumers blocked in FUTEX_WAIT on seq. */
+   uint32_t waiters;
+
+   /* Frames not exported because they did not fit in a slot. */
+   uint64_t dropped;
+};
+
+struct sgl_export_frame
+{
+   /* Frame number. 0 while the slot is being written. */
+   uint64_t seq;
+   /* Swap count, as in sgl_frame_timing. */
+   uint64_t sbc;
+   /* CPU time before the frame was swapped, and when it was published.
+    * Microseconds of CLOCK_MONOTONIC. */
+   int64_t cpu_swap_begin;
+   int64_t publish_time;
+
+   uint32_t width;
+   uint32_t height;
+   /* Bytes between rows. Rows are stored top to bottom. */
+   uint32_t stride;
+   /* SGL_PIXEL_FORMAT_*. 0 = RGBA, 1 = BGRA. */
+   uint32_t format;
+   uint32_t data_offset;
+   uint32_t reserved;
+};
+
+#endif
@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Function loader and extension set. Included by the platform backends.
+ *
+ * Each context gets a dispatch table with the entry points named in
+ * sgl_context_options::gl.procs, resolved once when the context is created.
+ * Core entry points are not added implicitly. Which ones exist depends on the
+ * version and profile actually created, and the application knows what it calls.
+ * The backends point g_gl_current at the table of whatever they make current.
+ *
+ * Extension names (GL and window system) are copied into one buffer and indexed by an
+ * open addressing hash set, so lookups don't scan the extension string. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef GL_NUM_EXTENSIONS
+#define GL_NUM_EXTENSIONS 0x821D
+#endif
+
+#ifdef _MSC_VER
+#define GL_THREAD_LOCAL __declspec(thread)
+#else
+#define GL_THREAD_LOCAL __thread
+#endif
+
+struct gl_dispatch
+{
+   sgl_function_t *procs;
+   unsigned num_procs;
+};
+
+static struct gl_dispatch g_gl_dispatch;
+static GL_THREAD_LOCAL const struct gl_dispatch *g_gl_current;
+
+static struct
+{
+   /* NUL separated names. Slots point into it. */
+   char *names;
+   const char **slots;
+   unsigned mask;
+} g_gl_extensions;
+
+static int gl_dispatch_init(struct gl_dispatch *dispatch, const char * const *names, unsigned num_names)
+{
+   unsigned i;
+
+   dispatch->procs = NULL;
+   dispatch->num_procs = 0;
+   if (!num_names)
+      return 1;
+
+   dispatch->procs = (sgl_function_t*)calloc(num_names, sizeof(*dispatch->procs));
+   if (!dispatch->procs)
+      return 0;
+
+   for (i = 0; i < num_names; i++)
+      dispatch->procs[i] = sgl_get_proc_address(names[i]);
+   dispatch->num_procs = num_names;
+   return 1;
+}
+
+static void gl_dispatch_free(struct gl_dispatch *dispatch)
+{
+   if (g_gl_current == dispatch)
+      g_gl_current = NULL;
+
+   free(dispatch->procs);
+   dispatch->procs = NULL;
+   dispatch->num_procs = 0;
+}
+
+/* FNV-1a. */
+static uint32_t gl_extension_hash(const char *name)
+{
+   uint32_t hash = 2166136261u;
+   for (; *name; name++)
+      hash = (hash ^ (uint8_t)*name) * 16777619u;
+   return hash;
+}
+
+static const char **gl_extension_slot(const char *name)
+{
+   unsigned i = gl_extension_hash(name) & g_gl_extensions.mask;
+   for (;; i = (i + 1) & g_gl_extensions.mask)
+   {
+      const char **slot = &g_gl_extensions.slots[i];
+      if (!*slot || strcmp(*slot, name) == 0)
+         return slot;
+   }
+}
+
+static void gl_extensions_free(void)
+{
+   free(g_gl_extensions.names);
+   free((void*)g_gl_extensions.slots);
+   memset(&g_gl_extensions, 0, sizeof(g_gl_extensions));
+}
+
+/* Builds the set from the current context's extensions and the window system's
+ * space separated extension string (may be NULL). */
+static int gl_extensions_init(const char *platform_exts)
+{
+   const GLubyte *(APIENTRY *get_stringi)(GLenum, GLuint) =
+      (const GLubyte *(APIENTRY *)(GLenum, GLuint))sgl_get_proc_address("glGetStringi");
+   const char *gl_exts = NULL;
+   GLint num_gl_exts = 0, i;
+   size_t size = 1, len;
+   unsigned count = 0, cap = 16;
+   char *out, *name;
+
+   gl_extensions_free();
+
+   /* Core profiles only expose extensions through glGetStringi(). */
+   glGetError();
+   if (get_stringi)
+      glGetIntegerv(GL_NUM_EXTENSIONS, &num_gl_exts);
+   if (glGetError() != GL_NO_ERROR || num_gl_exts <= 0)
+   {
+      num_gl_exts = 0;
+      gl_exts = (const char*)glGetString(GL_EXTENSIONS);
+   }
+
+   for (i = 0; i < num_gl_exts; i++)
+      size += strlen((const char*)get_stringi(GL_EXTENSIONS, i)) + 1;
+   if (gl_exts)
+      size += strlen(gl_exts) + 1;
+   if (platform_exts)
+      size += strlen(platform_exts) + 1;
+
+   g_gl_extensions.names = (char*)malloc(size);
+   if (!g_gl_extensions.names)
+      return 0;
+
+   /* Everything as one space separated string, then split in place. */
+   out = g_gl_extensions.names;
+   for (i = 0; i < num_gl_exts; i++)
+   {
+      len = strlen((const char*)get_stringi(GL_EXTENSIONS, i));
+      memcpy(out, get_stringi(GL_EXTENSIONS, i), len);
+      out += len;
+      *out++ = ' ';
+   }
+   if (gl_exts)
+   {
+      len = strlen(gl_exts);
+      memcpy(out, gl_exts, len);
+      out += len;
+      *out++ = ' ';
+   }
+   if (platform_exts)
+   {
+      len = strlen(platform_exts);
+      memcpy(out, platform_exts, len);
+      out += len;
+   }
+   *out = '\0';
+
+   for (name = g_gl_extensions.names; *name; name++)
+      if (*name != ' ' && (name == g_gl_extensions.names || name[-1] == ' '))
+         count++;
+
+   /* At most half full. */
+   while (cap < count * 2)
+      cap <<= 1;
+   g_gl_extensions.slots = (const char**)calloc(cap, sizeof(*g_gl_extensions.slots));
+   if (!g_gl_extensions.slots)
+   {
+      gl_extensions_free();
+      return 0;
+   }
+   g_gl_extensions.mask = cap - 1;
+
+   name = g_gl_extensions.names;
+   while (*name)
+   {
+      char *end;
+      const char **slot;
+
+      if (*name == ' ')
+      {
+         name++;
+         continue;
+      }
+
+      end = strchr(name, ' ');
+      if (end)
+         *end = '\0';
+
+      slot = gl_extension_slot(name);
+      if (!*slot)
+         *slot = name;
+
+      if (!end)
+         break;
+      name = end + 1;
+   }
+
+   return 1;
+}
+
+static int gl_has_extension(const char *name)
+{
+   if (!g_gl_extensions.slots)
+      return 0;
+   return *gl_extension_slot(name) != NULL;
+}
+
+int sgl_has_extension(const char *name)
+{
+   return gl_has_extension(name);
+}
+
+const sgl_function_t *sgl_get_dispatch_table(void)
+{
+   return g_gl_current ? g_gl_current->procs : NULL;
+}
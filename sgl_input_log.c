@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Input recording and replay. Included by the POSIX backends, which call
+// input_log_frame() at the start of every event pump, input_log_event() for every
+// queued event and input_replay_pump() once live events have been handled.
+//
+// The log is "SGLI", a version byte, then one record per event:
+//    frame delta     varint   Event pumps since the previous record.
+//    time delta      varint   Microseconds since the previous record (or start).
+//    type            byte     SGL_EVENT_* | pressed << 3.
+//    code            varint   Keys and buttons.
+//    x, y deltas     zigzag   Mouse events, relative to the previous mouse record.
+//
+// Records are appended to one of two preallocated buffers. A writer thread flushes the
+// other one, so the event path only allocates if the writer falls a whole buffer behind.
+
+#include <pthread.h>
+
+#define INPUT_LOG_MAGIC "SGLI"
+#define INPUT_LOG_VERSION 1
+#define INPUT_LOG_BUFFER_SIZE (64 * 1024)
+#define INPUT_LOG_MAX_RECORD 48
+
+struct input_log_buffer
+{
+   uint8_t *data;
+   size_t len;
+   size_t cap;
+};
+
+static struct
+{
+   bool active;
+   FILE *file;
+   bool write_error;
+
+   // The event path appends to buffers[current]. The writer owns the other one while pending.
+   struct input_log_buffer buffers[2];
+   unsigned current;
+   bool pending;
+   bool stop;
+
+   pthread_t thread;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   pthread_cond_t done;
+
+   uint64_t frame;
+   uint64_t last_frame;
+   int64_t last_time;
+   int last_x;
+   int last_y;
+} g_input_log;
+
+static struct
+{
+   bool active;
+   int mode;
+   uint8_t *data;
+   size_t size;
+   size_t pos;
+
+   uint64_t frame;
+   int64_t start;
+   int x;
+   int y;
+
+   // Decoded record waiting to be due.
+   bool have_next;
+   uint64_t next_frame;
+   int64_t next_time;
+   struct sgl_event next;
+} g_input_replay;
+
+static int64_t input_log_time_usec(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return (int64_t)tv.tv_sec * 1000000 + tv.tv_nsec / 1000;
+}
+
+static uint8_t *input_log_put_varint(uint8_t *out, uint64_t v)
+{
+   while (v >= 0x80)
+   {
+      *out++ = (uint8_t)(v | 0x80);
+      v >>= 7;
+   }
+   *out++ = (uint8_t)v;
+   return out;
+}
+
+static uint8_t *input_log_put_zigzag(uint8_t *out, int v)
+{
+   return input_log_put_varint(out, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+static void *input_log_thread(void *data)
+{
+   (void)data;
+
+   pthread_mutex_lock(&g_input_log.lock);
+   for (;;)
+   {
+      while (!g_input_log.pending && !g_input_log.stop)
+         pthread_cond_wait(&g_input_log.cond, &g_input_log.lock);
+      if (!g_input_log.pending)
+         break;
+
+      struct input_log_buffer *buf = &g_input_log.buffers[g_input_log.current ^ 1];
+      pthread_mutex_unlock(&g_input_log.lock);
+
+      bool ok = fwrite(buf->data, 1, buf->len, g_input_log.file) == buf->len;
+      buf->len = 0;
+
+      pthread_mutex_lock(&g_input_log.lock);
+      if (!ok)
+         g_input_log.write_error = true;
+      g_input_log.pending = false;
+      pthread_cond_signal(&g_input_log.done);
+   }
+   pthread_mutex_unlock(&g_input_log.lock);
+
+   return NULL;
+}
+
+// Hands the current buffer to the writer. If it is still busy, grows the current buffer instead.
+static void input_log_flush(bool wait)
+{
+   pthread_mutex_lock(&g_input_log.lock);
+   while (wait && g_input_log.pending)
+      pthread_cond_wait(&g_input_log.done, &g_input_log.lock);
+
+   if (!g_input_log.pending)
+   {
+      g_input_log.current ^= 1;
+      g_input_log.pending = true;
+      pthread_cond_signal(&g_input_log.cond);
+      pthread_mutex_unlock(&g_input_log.lock);
+      return;
+   }
+   pthread_mutex_unlock(&g_input_log.lock);
+
+   struct input_log_buffer *buf = &g_input_log.buffers[g_input_log.current];
+   uint8_t *data = realloc(buf->data, buf->cap * 2);
+   if (data)
+   {
+      buf->data = data;
+      buf->cap *= 2;
+   }
+}
+
+static void input_log_event(const struct sgl_event *ev)
+{
+   // Only the main window's input is recorded.
+   if (!g_input_log.active || ev->window)
+      return;
+
+   struct input_log_buffer *buf = &g_input_log.buffers[g_input_log.current];
+   if (buf->len + INPUT_LOG_MAX_RECORD > buf->cap)
+   {
+      input_log_flush(false);
+      buf = &g_input_log.buffers[g_input_log.current];
+      if (buf->len + INPUT_LOG_MAX_RECORD > buf->cap)
+         return;
+   }
+
+   int64_t now = input_log_time_usec();
+   uint8_t *out = buf->data + buf->len;
+   out = input_log_put_varint(out, g_input_log.frame - g_input_log.last_frame);
+   out = input_log_put_varint(out, now - g_input_log.last_time);
+   *out++ = (uint8_t)(ev->type | (ev->pressed ? 1 << 3 : 0));
+
+   if (ev->type == SGL_EVENT_KEY || ev->type == SGL_EVENT_MOUSE_BUTTON)
+      out = input_log_put_varint(out, (uint32_t)ev->code);
+
+   if (ev->type == SGL_EVENT_MOUSE_MOVE || ev->type == SGL_EVENT_MOUSE_BUTTON)
+   {
+      out = input_log_put_zigzag(out, ev->x - g_input_log.last_x);
+      out = input_log_put_zigzag(out, ev->y - g_input_log.last_y);
+      g_input_log.last_x = ev->x;
+      g_input_log.last_y = ev->y;
+   }
+
+   buf->len = out - buf->data;
+   g_input_log.last_frame = g_input_log.frame;
+   g_input_log.last_time = now;
+}
+
+static bool input_replay_get_varint(uint64_t *v)
+{
+   *v = 0;
+   for (unsigned shift = 0; shift < 64 && g_input_replay.pos < g_input_replay.size; shift += 7)
+   {
+      uint8_t byte = g_input_replay.data[g_input_replay.pos++];
+      *v |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+         return true;
+   }
+   return false;
+}
+
+static bool input_replay_get_zigzag(int *v)
+{
+   uint64_t u;
+   if (!input_replay_get_varint(&u))
+      return false;
+   *v = (int)((uint32_t)(u >> 1) ^ -(uint32_t)(u & 1));
+   return true;
+}
+
+static bool input_replay_decode(void)
+{
+   uint64_t frame_delta, time_delta, code = 0;
+   if (!input_replay_get_varint(&frame_delta) || !input_replay_get_varint(&time_delta) ||
+         g_input_replay.pos >= g_input_replay.size)
+      return false;
+
+   uint8_t type = g_input_replay.data[g_input_replay.pos++];
+   struct sgl_event *ev = &g_input_replay.next;
+   *ev = (struct sgl_event) {
+      .type    = type & 7,
+      .pressed = (type >> 3) & 1,
+   };
+
+   if (ev->type == SGL_EVENT_KEY || ev->type == SGL_EVENT_MOUSE_BUTTON)
+   {
+      if (!input_replay_get_varint(&code))
+         return false;
+      ev->code = (int)code;
+   }
+
+   if (ev->type == SGL_EVENT_MOUSE_MOVE || ev->type == SGL_EVENT_MOUSE_BUTTON)
+   {
+      int dx, dy;
+      if (!input_replay_get_zigzag(&dx) || !input_replay_get_zigzag(&dy))
+         return false;
+      g_input_replay.x += dx;
+      g_input_replay.y += dy;
+      ev->x = g_input_replay.x;
+      ev->y = g_input_replay.y;
+   }
+
+   g_input_replay.next_frame += frame_delta;
+   g_input_replay.next_time += time_delta;
+   g_input_replay.have_next = true;
+   return true;
+}
+
+static void input_log_frame(void)
+{
+   g_input_log.frame++;
+   g_input_replay.frame++;
+
+   // Keep the log on disk reasonably fresh without waiting for a full buffer.
+   if (g_input_log.active && g_input_log.buffers[g_input_log.current].len >= INPUT_LOG_BUFFER_SIZE / 4 &&
+         !__atomic_load_n(&g_input_log.pending, __ATOMIC_RELAXED))
+      input_log_flush(false);
+}
+
+static void queue_event(const struct sgl_event *ev);
+
+// Injects the events that are due in this event pump.
+static void input_replay_pump(void)
+{
+   if (!g_input_replay.active)
+      return;
+
+   int64_t elapsed = input_log_time_usec() - g_input_replay.start;
+   for (;;)
+   {
+      if (!g_input_replay.have_next && !input_replay_decode())
+      {
+         sgl_stop_input_replay();
+         return;
+      }
+
+      if (g_input_replay.mode == SGL_REPLAY_FRAME_LOCKED ?
+            g_input_replay.next_frame > g_input_replay.frame :
+            g_input_replay.next_time > elapsed)
+         return;
+
+      struct timespec tv;
+      clock_gettime(CLOCK_MONOTONIC, &tv);
+      g_input_replay.next.timestamp = (unsigned)((uint64_t)tv.tv_sec * 1000 + tv.tv_nsec / 1000000);
+      queue_event(&g_input_replay.next);
+      g_input_replay.have_next = false;
+   }
+}
+
+int sgl_start_input_recording(const char *path)
+{
+   sgl_stop_input_recording();
+   sgl_stop_input_replay();
+
+   g_input_log.file = fopen(path, "wb");
+   if (!g_input_log.file)
+   {
+      fprintf(stderr, "[SGL]: Failed to open %s for input recording.\n", path);
+      return SGL_ERROR;
+   }
+
+   for (unsigned i = 0; i < 2; i++)
+   {
+      g_input_log.buffers[i].data = malloc(INPUT_LOG_BUFFER_SIZE);
+      g_input_log.buffers[i].cap = INPUT_LOG_BUFFER_SIZE;
+   }
+
+   if (!g_input_log.buffers[0].data || !g_input_log.buffers[1].data)
+      goto error;
+
+   // Header goes through the buffer like everything else.
+   struct input_log_buffer *buf = &g_input_log.buffers[0];
+   memcpy(buf->data, INPUT_LOG_MAGIC, 4);
+   buf->data[4] = INPUT_LOG_VERSION;
+   buf->len = 5;
+
+   pthread_mutex_init(&g_input_log.lock, NULL);
+   pthread_cond_init(&g_input_log.cond, NULL);
+   pthread_cond_init(&g_input_log.done, NULL);
+   if (pthread_create(&g_input_log.thread, NULL, input_log_thread, NULL) != 0)
+   {
+      pthread_cond_destroy(&g_input_log.done);
+      pthread_cond_destroy(&g_input_log.cond);
+      pthread_mutex_destroy(&g_input_log.lock);
+      goto error;
+   }
+
+   g_input_log.last_frame = g_input_log.frame;
+   g_input_log.last_time = input_log_time_usec();
+   g_input_log.active = true;
+   return SGL_OK;
+
+error:
+   fclose(g_input_log.file);
+   free(g_input_log.buffers[0].data);
+   free(g_input_log.buffers[1].data);
+   memset(&g_input_log, 0, sizeof(g_input_log));
+   return SGL_ERROR;
+}
+
+void sgl_stop_input_recording(void)
+{
+   if (!g_input_log.active)
+      return;
+
+   input_log_flush(true);
+
+   pthread_mutex_lock(&g_input_log.lock);
+   g_input_log.stop = true;
+   pthread_cond_signal(&g_input_log.cond);
+   pthread_mutex_unlock(&g_input_log.lock);
+   pthread_join(g_input_log.thread, NULL);
+
+   pthread_cond_destroy(&g_input_log.done);
+   pthread_cond_destroy(&g_input_log.cond);
+   pthread_mutex_destroy(&g_input_log.lock);
+
+   if (fclose(g_input_log.file) != 0 || g_input_log.write_error)
+      fprintf(stderr, "[SGL]: Failed to write input log.\n");
+   free(g_input_log.buffers[0].data);
+   free(g_input_log.buffers[1].data);
+
+   uint64_t frame = g_input_log.frame;
+   memset(&g_input_log, 0, sizeof(g_input_log));
+   g_input_log.frame = frame;
+}
+
+int sgl_start_input_replay(const char *path, int mode)
+{
+   sgl_stop_input_recording();
+   sgl_stop_input_replay();
+
+   FILE *file = fopen(path, "rb");
+   if (!file)
+   {
+      fprintf(stderr, "[SGL]: Failed to open input log %s.\n", path);
+      return SGL_ERROR;
+   }
+
+   long size = -1;
+   if (fseek(file, 0, SEEK_END) == 0)
+      size = ftell(file);
+   rewind(file);
+
+   uint8_t *data = size > 5 ? malloc(size) : NULL;
+   if (!data || fread(data, 1, size, file) != (size_t)size ||
+         memcmp(data, INPUT_LOG_MAGIC, 4) != 0 || data[4] != INPUT_LOG_VERSION)
+   {
+      fprintf(stderr, "[SGL]: %s is not a valid input log.\n", path);
+      free(data);
+      fclose(file);
+      return SGL_ERROR;
+   }
+   fclose(file);
+
+   uint64_t frame = g_input_replay.frame;
+   memset(&g_input_replay, 0, sizeof(g_input_replay));
+   g_input_replay.data       = data;
+   g_input_replay.size       = size;
+   g_input_replay.pos        = 5;
+   g_input_replay.mode       = mode;
+   g_input_replay.frame      = frame;
+   g_input_replay.next_frame = frame;
+   g_input_replay.start      = input_log_time_usec();
+   g_input_replay.active     = true;
+   return SGL_OK;
+}
+
+int sgl_is_replaying(void)
+{
+   return g_input_replay.active;
+}
+
+void sgl_stop_input_replay(void)
+{
+   free(g_input_replay.data);
+
+   uint64_t frame = g_input_replay.frame;
+   memset(&g_input_replay, 0, sizeof(g_input_replay));
+   g_input_replay.frame = frame;
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Pixel conversion kernels for captured frames. Included by the platform backends.
+ * SSE2 and NEON are used when the compiler targets them. AVX2 is picked at runtime with GCC and Clang. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PIXEL_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PIXEL_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+/* Swaps the R and B channels of 32-bit pixels. dst may equal src. */
+static void pixel_swizzle_rb_scalar(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+   size_t i;
+   for (i = 0; i < pixels; i++, dst += 4, src += 4)
+   {
+      uint8_t r = src[0];
+      uint8_t b = src[2];
+      dst[0] = b;
+      dst[1] = src[1];
+      dst[2] = r;
+      dst[3] = src[3];
+   }
+}
+
+#ifdef PIXEL_HAVE_SSE2
+static size_t pixel_swizzle_rb_sse2(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+   size_t i;
+   const __m128i mask_ga = _mm_set1_epi32(0xff00ff00);
+
+   for (i = 0; i + 4 <= pixels; i += 4)
+   {
+      __m128i v  = _mm_loadu_si128((const __m128i*)(src + i * 4));
+      __m128i ga = _mm_and_si128(v, mask_ga);
+      __m128i rb = _mm_andnot_si128(mask_ga, v);
+
+      /* Swap the 16-bit halves of each pixel, moving R and B past each other. */
+      rb = _mm_shufflelo_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+      rb = _mm_shufflehi_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1));
+      _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(ga, rb));
+   }
+
+   return i;
+}
+#endif
+
+#ifdef PIXEL_HAVE_AVX2
+__attribute__((target("avx2")))
+static size_t pixel_swizzle_rb_avx2(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+   size_t i;
+   const __m256i shuf = _mm256_setr_epi8(
+         2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+         2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+   for (i = 0; i + 8 <= pixels; i += 8)
+   {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+      _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(v, shuf));
+   }
+
+   return i;
+}
+
+static int pixel_have_avx2(void)
+{
+   static int have = -1;
+   if (have < 0)
+   {
+      __builtin_cpu_init();
+      have = __builtin_cpu_supports("avx2") ? 1 : 0;
+   }
+   return have;
+}
+#endif
+
+#ifdef PIXEL_HAVE_NEON
+static size_t pixel_swizzle_rb_neon(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+   size_t i;
+   for (i = 0; i + 16 <= pixels; i += 16)
+   {
+      uint8x16x4_t v = vld4q_u8(src + i * 4);
+      uint8x16_t tmp = v.val[0];
+      v.val[0] = v.val[2];
+      v.val[2] = tmp;
+      vst4q_u8(dst + i * 4, v);
+   }
+
+   return i;
+}
+#endif
+
+static void pixel_swizzle_rb(uint8_t *dst, const uint8_t *src, size_t pixels)
+{
+   size_t done = 0;
+
+#ifdef PIXEL_HAVE_AVX2
+   if (pixel_have_avx2())
+      done = pixel_swizzle_rb_avx2(dst, src, pixels);
+#endif
+#ifdef PIXEL_HAVE_SSE2
+   done += pixel_swizzle_rb_sse2(dst + done * 4, src + done * 4, pixels - done);
+#endif
+#ifdef PIXEL_HAVE_NEON
+   done += pixel_swizzle_rb_neon(dst + done * 4, src + done * 4, pixels - done);
+#endif
+
+   pixel_swizzle_rb_scalar(dst + done * 4, src + done * 4, pixels - done);
+}
+
+/* Copies a 32-bit image, optionally swapping R and B and flipping it vertically. */
+static void pixel_copy_image(uint8_t *dst, size_t dst_stride,
+      const uint8_t *src, size_t src_stride,
+      unsigned width, unsigned height, int swizzle, int flip)
+{
+   unsigned y;
+   ptrdiff_t src_step = (ptrdiff_t)src_stride;
+   if (flip && height)
+   {
+      src += (size_t)(height - 1) * src_stride;
+      src_step = -src_step;
+   }
+
+   for (y = 0; y < height; y++, dst += dst_stride, src += src_step)
+   {
+      if (swizzle)
+         pixel_swizzle_rb(dst, src, width);
+      else
+         memcpy(dst, src, (size_t)width * 4);
+   }
+}
+
+/* RGBA to I420, BT.601 limited range. Chroma is the rounded average of each 2x2 block.
+ * The +32896 folds in the +128 chroma offset and rounding while keeping sums non-negative. */
+#define PIXEL_Y(r, g, b) ((uint8_t)(((66 * (r) + 129 * (g) + 25 * (b) + 128) >> 8) + 16))
+#define PIXEL_U(r, g, b) ((uint8_t)((-38 * (r) - 74 * (g) + 112 * (b) + 32896) >> 8))
+#define PIXEL_V(r, g, b) ((uint8_t)((112 * (r) - 94 * (g) - 18 * (b) + 32896) >> 8))
+
+static void pixel_i420_row_y_scalar(uint8_t *dst, const uint8_t *src, unsigned begin, unsigned end)
+{
+   unsigned x;
+   for (x = begin; x < end; x++)
+      dst[x] = PIXEL_Y(src[x * 4 + 0], src[x * 4 + 1], src[x * 4 + 2]);
+}
+
+/* Chroma for columns [begin, end) of a pair of rows. row1 may equal row0 for odd heights. */
+static void pixel_i420_row_uv_scalar(uint8_t *u, uint8_t *v,
+      const uint8_t *row0, const uint8_t *row1, unsigned width, unsigned begin, unsigned end)
+{
+   unsigned x;
+   for (x = begin; x < end; x++)
+   {
+      unsigned x0 = x * 2;
+      unsigned x1 = x0 + 1 < width ? x0 + 1 : x0;
+      int r = (row0[x0 * 4 + 0] + row0[x1 * 4 + 0] + row1[x0 * 4 + 0] + row1[x1 * 4 + 0] + 2) >> 2;
+      int g = (row0[x0 * 4 + 1] + row0[x1 * 4 + 1] + row1[x0 * 4 + 1] + row1[x1 * 4 + 1] + 2) >> 2;
+      int b = (row0[x0 * 4 + 2] + row0[x1 * 4 + 2] + row1[x0 * 4 + 2] + row1[x1 * 4 + 2] + 2) >> 2;
+      u[x] = PIXEL_U(r, g, b);
+      v[x] = PIXEL_V(r, g, b);
+   }
+}
+
+#ifdef PIXEL_HAVE_SSE2
+/* Dot product of the RGB channels of four 16-bit pixels with coeffs, as four 32-bit sums. */
+static __m128i pixel_dot4_sse2(__m128i p01, __m128i p23, __m128i coeffs)
+{
+   __m128 a = _mm_castsi128_ps(_mm_madd_epi16(p01, coeffs));
+   __m128 b = _mm_castsi128_ps(_mm_madd_epi16(p23, coeffs));
+   __m128i even = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+   __m128i odd = _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+   return _mm_add_epi32(even, odd);
+}
+
+static unsigned pixel_i420_row_y_sse2(uint8_t *dst, const uint8_t *src, unsigned width)
+{
+   unsigned x;
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i coeffs = _mm_setr_epi16(66, 129, 25, 0, 66, 129, 25, 0);
+   const __m128i bias = _mm_set1_epi32(128 + (16 << 8));
+
+   for (x = 0; x + 8 <= width; x += 8)
+   {
+      __m128i p0 = _mm_loadu_si128((const __m128i*)(src + x * 4));
+      __m128i p1 = _mm_loadu_si128((const __m128i*)(src + x * 4 + 16));
+      __m128i y0 = pixel_dot4_sse2(_mm_unpacklo_epi8(p0, zero), _mm_unpackhi_epi8(p0, zero), coeffs);
+      __m128i y1 = pixel_dot4_sse2(_mm_unpacklo_epi8(p1, zero), _mm_unpackhi_epi8(p1, zero), coeffs);
+      y0 = _mm_srai_epi32(_mm_add_epi32(y0, bias), 8);
+      y1 = _mm_srai_epi32(_mm_add_epi32(y1, bias), 8);
+      _mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(_mm_packs_epi32(y0, y1), zero));
+   }
+
+   return x;
+}
+
+/* Averages 2x2 blocks of four pixels from each row into two 16-bit pixels. */
+static __m128i pixel_avg2x2_sse2(__m128i row0, __m128i row1)
+{
+   const __m128i zero = _mm_setzero_si128();
+   __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+   __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+   lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+   hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+   return _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_set1_epi16(2)), 2);
+}
+
+/* Returns the number of chroma samples done. Only full 2x2 blocks are handled. */
+static unsigned pixel_i420_row_uv_sse2(uint8_t *u, uint8_t *v,
+      const uint8_t *row0, const uint8_t *row1, unsigned width)
+{
+   unsigned x;
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i u_coeffs = _mm_setr_epi16(-38, -74, 112, 0, -38, -74, 112, 0);
+   const __m128i v_coeffs = _mm_setr_epi16(112, -94, -18, 0, 112, -94, -18, 0);
+   const __m128i bias = _mm_set1_epi32(32896);
+
+   for (x = 0; x * 2 + 8 <= width; x += 4)
+   {
+      __m128i c01 = pixel_avg2x2_sse2(_mm_loadu_si128((const __m128i*)(row0 + x * 8)),
+            _mm_loadu_si128((const __m128i*)(row1 + x * 8)));
+      __m128i c23 = pixel_avg2x2_sse2(_mm_loadu_si128((const __m128i*)(row0 + x * 8 + 16)),
+            _mm_loadu_si128((const __m128i*)(row1 + x * 8 + 16)));
+
+      __m128i us = _mm_srai_epi32(_mm_add_epi32(pixel_dot4_sse2(c01, c23, u_coeffs), bias), 8);
+      __m128i vs = _mm_srai_epi32(_mm_add_epi32(pixel_dot4_sse2(c01, c23, v_coeffs), bias), 8);
+      __m128i uv = _mm_packus_epi16(_mm_packs_epi32(us, vs), zero);
+      int u4 = _mm_cvtsi128_si32(uv);
+      int v4 = _mm_cvtsi128_si32(_mm_srli_si128(uv, 4));
+
+      memcpy(u + x, &u4, 4);
+      memcpy(v + x, &v4, 4);
+   }
+
+   return x;
+}
+#endif
+
+/* Converts an RGBA image with rows top to bottom into I420 planes.
+ * The chroma planes are (width + 1) / 2 by (height + 1) / 2. */
+static void pixel_rgba_to_i420(uint8_t *y_plane, uint8_t *u_plane, uint8_t *v_plane,
+      const uint8_t *src, size_t stride, unsigned width, unsigned height)
+{
+   unsigned y;
+   unsigned chroma_width = (width + 1) / 2;
+
+   for (y = 0; y < height; y++)
+   {
+      const uint8_t *row = src + y * stride;
+      unsigned done = 0;
+#ifdef PIXEL_HAVE_SSE2
+      done = pixel_i420_row_y_sse2(y_plane + (size_t)y * width, row, width);
+#endif
+      pixel_i420_row_y_scalar(y_plane + (size_t)y * width, row, done, width);
+   }
+
+   for (y = 0; y < height; y += 2)
+   {
+      const uint8_t *row0 = src + y * stride;
+      const uint8_t *row1 = y + 1 < height ? row0 + stride : row0;
+      uint8_t *u = u_plane + (size_t)(y / 2) * chroma_width;
+      uint8_t *v = v_plane + (size_t)(y / 2) * chroma_width;
+      unsigned done = 0;
+#ifdef PIXEL_HAVE_SSE2
+      done = pixel_i420_row_uv_sse2(u, v, row0, row1, width);
+#endif
+      pixel_i420_row_uv_scalar(u, v, row0, row1, width, done, chroma_width);
+   }
+}
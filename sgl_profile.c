@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Frame loop profiler. Included by the platform backends.
+ * Build with -DSGL_PROFILE to enable. When disabled, PROFILE_BEGIN/PROFILE_END expand to nothing. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SGL_PROFILE
+
+#if defined(_WIN32)
+#include <intrin.h>
+#define profile_atomic_add(ptr, val) InterlockedExchangeAdd64((volatile LONG64*)(ptr), (LONG64)(val))
+#define profile_atomic_load(ptr) ((uint64_t)InterlockedCompareExchange64((volatile LONG64*)(ptr), 0, 0))
+#define profile_atomic_store(ptr, val) InterlockedExchange64((volatile LONG64*)(ptr), (LONG64)(val))
+#else
+#include <time.h>
+#define profile_atomic_add(ptr, val) __atomic_fetch_add(ptr, val, __ATOMIC_RELAXED)
+#define profile_atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define profile_atomic_store(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#endif
+
+/* Log-linear histogram. Each power of two is split in 1 << PROFILE_SUB_BITS buckets,
+ * so a bucket is never wider than 12.5% of its lower bound. */
+#define PROFILE_SUB_BITS 3
+#define PROFILE_BUCKETS (64 << PROFILE_SUB_BITS)
+
+struct profile_phase
+{
+   uint64_t count;
+   uint64_t total;
+   uint64_t min;
+   uint64_t max;
+   uint64_t buckets[PROFILE_BUCKETS];
+};
+
+static struct profile_phase g_profile[SGL_PROFILE_PHASES];
+
+static uint64_t profile_time_nsec(void)
+{
+#if defined(_WIN32)
+   static LARGE_INTEGER freq;
+   LARGE_INTEGER count;
+   if (!freq.QuadPart)
+      QueryPerformanceFrequency(&freq);
+   QueryPerformanceCounter(&count);
+   return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000 +
+      (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return (uint64_t)tv.tv_sec * 1000000000 + tv.tv_nsec;
+#endif
+}
+
+static unsigned profile_log2(uint64_t v)
+{
+#if defined(__GNUC__)
+   return 63 - __builtin_clzll(v);
+#else
+   unsigned ret = 0;
+   while (v >>= 1)
+      ret++;
+   return ret;
+#endif
+}
+
+static unsigned profile_bucket(uint64_t ns)
+{
+   unsigned log2, sub;
+   if (ns < (1 << PROFILE_SUB_BITS))
+      return (unsigned)ns;
+
+   log2 = profile_log2(ns);
+   sub = (unsigned)(ns >> (log2 - PROFILE_SUB_BITS)) & ((1 << PROFILE_SUB_BITS) - 1);
+   return ((log2 - PROFILE_SUB_BITS + 1) << PROFILE_SUB_BITS) + sub;
+}
+
+/* Lower bound of a bucket. */
+static uint64_t profile_bucket_value(unsigned bucket)
+{
+   unsigned log2, sub;
+   if (bucket < (1 << PROFILE_SUB_BITS))
+      return bucket;
+   if (bucket >= PROFILE_BUCKETS)
+      return UINT64_MAX;
+
+   log2 = (bucket >> PROFILE_SUB_BITS) + PROFILE_SUB_BITS - 1;
+   sub = bucket & ((1 << PROFILE_SUB_BITS) - 1);
+   return (uint64_t)((1 << PROFILE_SUB_BITS) + sub) << (log2 - PROFILE_SUB_BITS);
+}
+
+static void profile_record(unsigned phase, uint64_t ns)
+{
+   struct profile_phase *p = &g_profile[phase];
+
+   profile_atomic_add(&p->count, 1);
+   profile_atomic_add(&p->total, ns);
+   profile_atomic_add(&p->buckets[profile_bucket(ns)], 1);
+
+   /* Only ever updated from the thread running the frame loop. */
+   if (ns > profile_atomic_load(&p->max))
+      profile_atomic_store(&p->max, ns);
+   if (ns < profile_atomic_load(&p->min) || !profile_atomic_load(&p->min))
+      profile_atomic_store(&p->min, ns);
+}
+
+/* Milliseconds on the clock input events are timestamped with. */
+static uint32_t profile_event_clock_ms(void)
+{
+#if defined(_WIN32)
+   return GetTickCount();
+#else
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return (uint32_t)((uint64_t)tv.tv_sec * 1000 + tv.tv_nsec / 1000000);
+#endif
+}
+
+static void profile_input_latency(const struct sgl_event *ev)
+{
+   uint32_t latency = profile_event_clock_ms() - ev->timestamp;
+   unsigned phase;
+
+   switch (ev->type)
+   {
+      case SGL_EVENT_KEY:
+         phase = SGL_PROFILE_KEY_LATENCY;
+         break;
+      case SGL_EVENT_MOUSE_MOVE:
+         phase = SGL_PROFILE_MOUSE_MOVE_LATENCY;
+         break;
+      case SGL_EVENT_MOUSE_BUTTON:
+         phase = SGL_PROFILE_MOUSE_BUTTON_LATENCY;
+         break;
+      default:
+         return;
+   }
+
+   /* Anything this large means the clocks don't match, e.g. a remote X server. */
+   if (latency > 10000)
+      return;
+
+   profile_record(phase, (uint64_t)latency * 1000000);
+}
+
+static void profile_reset(void)
+{
+   memset(g_profile, 0, sizeof(g_profile));
+}
+
+/* Bucket midpoints are clamped to the observed range, so sparse phases don't report p50 > max. */
+static uint64_t profile_percentile(const uint64_t *buckets, uint64_t count, unsigned percent,
+      uint64_t min, uint64_t max)
+{
+   unsigned i;
+   uint64_t seen = 0;
+   uint64_t target = (count * percent + 99) / 100;
+
+   for (i = 0; i < PROFILE_BUCKETS; i++)
+   {
+      seen += buckets[i];
+      if (seen >= target && seen)
+      {
+         /* Report middle of the bucket. */
+         uint64_t lo = profile_bucket_value(i);
+         uint64_t hi = profile_bucket_value(i + 1);
+         uint64_t mid = hi == UINT64_MAX ? lo : lo + (hi - lo) / 2;
+         return mid < min ? min : mid > max ? max : mid;
+      }
+   }
+
+   return 0;
+}
+
+int sgl_get_profile(struct sgl_profile *profile)
+{
+   unsigned i, j;
+   uint64_t buckets[PROFILE_BUCKETS];
+
+   for (i = 0; i < SGL_PROFILE_PHASES; i++)
+   {
+      struct sgl_profile_phase *out = &profile->phases[i];
+      struct profile_phase *p = &g_profile[i];
+      uint64_t count = 0;
+
+      for (j = 0; j < PROFILE_BUCKETS; j++)
+      {
+         buckets[j] = profile_atomic_load(&p->buckets[j]);
+         count += buckets[j];
+      }
+
+      out->count = count;
+      out->total = profile_atomic_load(&p->total);
+      out->min   = profile_atomic_load(&p->min);
+      out->max   = profile_atomic_load(&p->max);
+      out->p50   = profile_percentile(buckets, count, 50, out->min, out->max);
+      out->p95   = profile_percentile(buckets, count, 95, out->min, out->max);
+      out->p99   = profile_percentile(buckets, count, 99, out->min, out->max);
+   }
+
+   return SGL_OK;
+}
+
+static const char *profile_phase_name(unsigned phase)
+{
+   static const char *names[SGL_PROFILE_PHASES] = {
+      "pump",
+      "dispatch",
+      "resize",
+      "swap",
+      "init",
+      "deinit",
+      "key_latency",
+      "motion_latency",
+      "button_latency",
+   };
+
+   return names[phase];
+}
+
+static void profile_dump_json(const struct sgl_profile *profile)
+{
+   unsigned i;
+   const char *sep = "";
+
+   fprintf(stderr, "{\"sgl_profile\":{");
+   for (i = 0; i < SGL_PROFILE_PHASES; i++)
+   {
+      const struct sgl_profile_phase *p = &profile->phases[i];
+      fprintf(stderr, "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"min_ns\":%llu,\"max_ns\":%llu,"
+            "\"p50_ns\":%llu,\"p95_ns\":%llu,\"p99_ns\":%llu}",
+            sep, profile_phase_name(i),
+            (unsigned long long)p->count, (unsigned long long)p->total,
+            (unsigned long long)p->min, (unsigned long long)p->max,
+            (unsigned long long)p->p50, (unsigned long long)p->p95, (unsigned long long)p->p99);
+      sep = ",";
+   }
+   fprintf(stderr, "}}\n");
+}
+
+/* Dumps the profile to stderr if SGL_PROFILE is set in the environment. */
+static void profile_dump(void)
+{
+   unsigned i;
+   struct sgl_profile profile;
+   const char *env = getenv("SGL_PROFILE");
+   if (!env)
+      return;
+
+   sgl_get_profile(&profile);
+
+   if (strcmp(env, "json") == 0)
+   {
+      profile_dump_json(&profile);
+      return;
+   }
+
+   fprintf(stderr, "[SGL]: Profile (usec)   count       avg       p50       p95       p99       max\n");
+   for (i = 0; i < SGL_PROFILE_PHASES; i++)
+   {
+      const struct sgl_profile_phase *p = &profile.phases[i];
+      if (!p->count)
+         continue;
+
+      fprintf(stderr, "[SGL]: %-12s %10llu %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+            profile_phase_name(i),
+            (unsigned long long)p->count,
+            p->total / (p->count * 1000.0),
+            p->p50 / 1000.0, p->p95 / 1000.0, p->p99 / 1000.0, p->max / 1000.0);
+   }
+}
+
+#define PROFILE_BEGIN(var) uint64_t var = profile_time_nsec()
+#define PROFILE_END(phase, var) profile_record(phase, profile_time_nsec() - (var))
+#define PROFILE_INPUT(ev) profile_input_latency(ev)
+
+#else
+
+int sgl_get_profile(struct sgl_profile *profile)
+{
+   (void)profile;
+   return SGL_ERROR;
+}
+
+static void profile_reset(void) {}
+static void profile_dump(void) {}
+
+#define PROFILE_BEGIN(var)
+#define PROFILE_END(phase, var)
+#define PROFILE_INPUT(ev)
+
+#endif
@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// RandR 1.2+ monitor and mode enumeration. Included by sgl_x11.c if SGL_HAVE_XRANDR is defined.
+// Monitors are the connected outputs driven by a CRTC: the primary output first, then the others
+// left to right, top to bottom. sgl_resolution::monitor_index indexes this list.
+//
+// The list is cached per connection and dropped on RRScreenChangeNotify. Before sgl_init(),
+// queries go through a private connection which is kept until sgl_init() or sgl_deinit(),
+// so repeated sgl_get_desktop_modes() calls don't reconnect either.
+
+#include <X11/extensions/Xrandr.h>
+
+struct randr_mode
+{
+   RRMode id;
+   unsigned width;
+   unsigned height;
+   unsigned refresh_mhz;
+};
+
+struct randr_monitor
+{
+   RRCrtc crtc;
+   RROutput output;
+   int x;
+   int y;
+   unsigned width;
+   unsigned height;
+   RRMode mode;
+   Rotation rotation;
+
+   // Range in g_randr.modes. The current mode comes first.
+   unsigned first_mode;
+   unsigned num_modes;
+};
+
+static struct
+{
+   // Connection the cache belongs to.
+   Display *dpy;
+   Display *private_dpy;
+   bool queried;
+   bool available;
+   int event_base;
+
+   // Exclusive fullscreen went through RandR. saved holds the CRTC state to restore, if it changed.
+   bool fullscreen;
+   struct
+   {
+      bool active;
+      RRCrtc crtc;
+      RRMode mode;
+      Rotation rotation;
+      int x;
+      int y;
+      RROutput *outputs;
+      int num_outputs;
+   } saved;
+
+   bool valid;
+   struct randr_monitor *monitors;
+   unsigned num_monitors;
+   struct randr_mode *modes;
+   unsigned num_modes;
+} g_randr;
+
+static unsigned randr_refresh_mhz(const XRRModeInfo *info)
+{
+   uint64_t total = (uint64_t)info->hTotal * info->vTotal;
+   if (info->modeFlags & RR_DoubleScan)
+      total *= 2;
+   if (info->modeFlags & RR_Interlace)
+      total /= 2;
+   if (!total)
+      return 0;
+
+   return (unsigned)(((uint64_t)info->dotClock * 1000 + total / 2) / total);
+}
+
+static void randr_invalidate(void)
+{
+   free(g_randr.monitors);
+   free(g_randr.modes);
+   g_randr.monitors = NULL;
+   g_randr.modes = NULL;
+   g_randr.num_monitors = 0;
+   g_randr.num_modes = 0;
+   g_randr.valid = false;
+}
+
+// Switches the cache to dpy and checks for RandR 1.2 once per connection.
+static bool randr_init(Display *dpy)
+{
+   if (g_randr.dpy != dpy)
+   {
+      randr_invalidate();
+      if (g_randr.private_dpy && g_randr.private_dpy != dpy)
+      {
+         XCloseDisplay(g_randr.private_dpy);
+         g_randr.private_dpy = NULL;
+      }
+
+      g_randr.dpy = dpy;
+      g_randr.queried = false;
+      g_randr.available = false;
+   }
+
+   if (!g_randr.queried)
+   {
+      g_randr.queried = true;
+
+      int error_base, major = 0, minor = 0;
+      if (XRRQueryExtension(dpy, &g_randr.event_base, &error_base) &&
+            XRRQueryVersion(dpy, &major, &minor) && (major > 1 || (major == 1 && minor >= 2)))
+      {
+         g_randr.available = true;
+         XRRSelectInput(dpy, DefaultRootWindow(dpy), RRScreenChangeNotifyMask);
+      }
+   }
+
+   return g_randr.available;
+}
+
+static void randr_deinit(void)
+{
+   randr_invalidate();
+   free(g_randr.saved.outputs);
+   if (g_randr.private_dpy)
+      XCloseDisplay(g_randr.private_dpy);
+   memset(&g_randr, 0, sizeof(g_randr));
+}
+
+// Returns true if the event was a RandR event.
+static bool randr_handle_event(XEvent *event)
+{
+   if (!g_randr.available || event->type != g_randr.event_base + RRScreenChangeNotify)
+      return false;
+
+   XRRUpdateConfiguration(event);
+   randr_invalidate();
+   return true;
+}
+
+static int randr_compare_monitors(const void *a_, const void *b_)
+{
+   const struct randr_monitor *a = a_;
+   const struct randr_monitor *b = b_;
+   if (a->x != b->x)
+      return a->x < b->x ? -1 : 1;
+   if (a->y != b->y)
+      return a->y < b->y ? -1 : 1;
+   return 0;
+}
+
+static const XRRModeInfo *randr_find_mode(const XRRScreenResources *res, RRMode id)
+{
+   for (int i = 0; i < res->nmode; i++)
+      if (res->modes[i].id == id)
+         return &res->modes[i];
+   return NULL;
+}
+
+static void randr_add_mode(const XRRModeInfo *info, Rotation rotation)
+{
+   struct randr_mode *mode = &g_randr.modes[g_randr.num_modes++];
+   bool swap = rotation & (RR_Rotate_90 | RR_Rotate_270);
+
+   mode->id          = info->id;
+   mode->width       = swap ? info->height : info->width;
+   mode->height      = swap ? info->width : info->height;
+   mode->refresh_mhz = randr_refresh_mhz(info);
+}
+
+static bool randr_update(void)
+{
+   if (g_randr.valid)
+      return true;
+   if (!g_randr.available)
+      return false;
+
+   Display *dpy = g_randr.dpy;
+   Window root = DefaultRootWindow(dpy);
+   XRRScreenResources *res = XRRGetScreenResourcesCurrent(dpy, root);
+   if (!res)
+      return false;
+
+   // Upper bounds. Each output lists at most every mode once.
+   g_randr.monitors = calloc(res->noutput ? res->noutput : 1, sizeof(*g_randr.monitors));
+   g_randr.modes = calloc((size_t)res->noutput * res->nmode + 1, sizeof(*g_randr.modes));
+   if (!g_randr.monitors || !g_randr.modes)
+   {
+      randr_invalidate();
+      XRRFreeScreenResources(res);
+      return false;
+   }
+
+   RROutput primary = XRRGetOutputPrimary(dpy, root);
+   for (int i = 0; i < res->noutput; i++)
+   {
+      XRROutputInfo *output = XRRGetOutputInfo(dpy, res, res->outputs[i]);
+      if (!output)
+         continue;
+      if (output->connection != RR_Connected || !output->crtc)
+      {
+         XRRFreeOutputInfo(output);
+         continue;
+      }
+
+      XRRCrtcInfo *crtc = XRRGetCrtcInfo(dpy, res, output->crtc);
+      const XRRModeInfo *current = crtc ? randr_find_mode(res, crtc->mode) : NULL;
+      if (!current)
+      {
+         if (crtc)
+            XRRFreeCrtcInfo(crtc);
+         XRRFreeOutputInfo(output);
+         continue;
+      }
+
+      struct randr_monitor *mon = &g_randr.monitors[g_randr.num_monitors++];
+      mon->crtc       = output->crtc;
+      mon->output     = res->outputs[i];
+      mon->x          = crtc->x;
+      mon->y          = crtc->y;
+      mon->width      = crtc->width;
+      mon->height     = crtc->height;
+      mon->mode       = crtc->mode;
+      mon->rotation   = crtc->rotation;
+      mon->first_mode = g_randr.num_modes;
+
+      randr_add_mode(current, crtc->rotation);
+      for (int j = 0; j < output->nmode; j++)
+      {
+         const XRRModeInfo *info = randr_find_mode(res, output->modes[j]);
+         if (info && info->id != crtc->mode)
+            randr_add_mode(info, crtc->rotation);
+      }
+      mon->num_modes = g_randr.num_modes - mon->first_mode;
+
+      XRRFreeCrtcInfo(crtc);
+      XRRFreeOutputInfo(output);
+   }
+   XRRFreeScreenResources(res);
+
+   qsort(g_randr.monitors, g_randr.num_monitors, sizeof(*g_randr.monitors), randr_compare_monitors);
+   for (unsigned i = 1; i < g_randr.num_monitors; i++)
+   {
+      if (g_randr.monitors[i].output == primary)
+      {
+         struct randr_monitor mon = g_randr.monitors[i];
+         memmove(&g_randr.monitors[1], &g_randr.monitors[0], i * sizeof(mon));
+         g_randr.monitors[0] = mon;
+         break;
+      }
+   }
+
+   g_randr.valid = true;
+   return true;
+}
+
+// Out of range indices fall back to the first monitor.
+static const struct randr_monitor *randr_get_monitor(Display *dpy, unsigned index)
+{
+   if (!randr_init(dpy) || !randr_update() || !g_randr.num_monitors)
+      return NULL;
+
+   if (index >= g_randr.num_monitors)
+   {
+      fprintf(stderr, "[SGL]: Monitor %u does not exist, using monitor 0.\n", index);
+      index = 0;
+   }
+   return &g_randr.monitors[index];
+}
+
+static struct sgl_resolution *randr_get_desktop_modes(unsigned *num_modes)
+{
+   Display *dpy = g_dpy;
+   if (!dpy)
+   {
+      if (!g_randr.private_dpy)
+         g_randr.private_dpy = open_display();
+      dpy = g_randr.private_dpy;
+      if (!dpy)
+         return NULL;
+
+      // Nobody else reads this connection. Only the root window's RandR events are selected.
+      if (g_randr.dpy == dpy)
+      {
+         XEvent event;
+         while (XPending(dpy))
+         {
+            XNextEvent(dpy, &event);
+            randr_handle_event(&event);
+         }
+      }
+   }
+
+   if (!randr_init(dpy) || !randr_update() || !g_randr.num_modes)
+      return NULL;
+
+   struct sgl_resolution *modes = calloc(g_randr.num_modes, sizeof(*modes));
+   if (!modes)
+      return NULL;
+
+   unsigned num = 0;
+   for (unsigned i = 0; i < g_randr.num_monitors; i++)
+   {
+      const struct randr_monitor *mon = &g_randr.monitors[i];
+      for (unsigned j = 0; j < mon->num_modes; j++)
+      {
+         const struct randr_mode *mode = &g_randr.modes[mon->first_mode + j];
+         modes[num].width         = mode->width;
+         modes[num].height        = mode->height;
+         modes[num].monitor_index = i;
+         modes[num].refresh_mhz   = mode->refresh_mhz;
+         num++;
+      }
+   }
+
+   *num_modes = num;
+   return modes;
+}
+
+// Lower is better. Sizes that fit the request come first, then the refresh rate decides.
+struct randr_score
+{
+   uint64_t size;
+   uint64_t refresh;
+};
+
+static struct randr_score randr_score_mode(const struct randr_mode *mode, const struct sgl_resolution *req,
+      unsigned desktop_mhz)
+{
+   struct randr_score score;
+   uint64_t area = (uint64_t)mode->width * mode->height;
+   uint64_t req_area = (uint64_t)req->width * req->height;
+
+   // Exact size, then the smallest larger mode, then the largest smaller one.
+   if (mode->width == req->width && mode->height == req->height)
+      score.size = 0;
+   else if (mode->width >= req->width && mode->height >= req->height)
+      score.size = 1 + area - req_area;
+   else
+      score.size = ((uint64_t)1 << 48) - area;
+
+   unsigned r = mode->refresh_mhz;
+   if (req->refresh_mhz)
+      score.refresh = r > req->refresh_mhz ? r - req->refresh_mhz : req->refresh_mhz - r;
+   else if (req->content_mhz)
+   {
+      // Distance to the nearest integer multiple of the content rate. Ties go to the faster mode.
+      uint64_t multiple = ((uint64_t)r + req->content_mhz / 2) / req->content_mhz;
+      if (!multiple)
+         multiple = 1;
+      uint64_t target = multiple * req->content_mhz;
+      uint64_t error = r > target ? r - target : target - r;
+      score.refresh = (error << 24) + (0xffffff - (r >> 8));
+   }
+   else
+   {
+      // Keep the desktop rate if possible, otherwise the fastest.
+      uint64_t error = r > desktop_mhz ? r - desktop_mhz : desktop_mhz - r;
+      score.refresh = (error << 24) + (0xffffff - (r >> 8));
+   }
+
+   return score;
+}
+
+static bool randr_better(struct randr_score a, struct randr_score b)
+{
+   return a.size < b.size || (a.size == b.size && a.refresh < b.refresh);
+}
+
+// Picks the best mode on req->monitor_index and switches only that monitor's CRTC.
+// Modes that don't fit in the current screen are skipped, as using them would resize the screen.
+// Returns the area the fullscreen window should cover.
+static bool randr_set_fullscreen_mode(Display *dpy, int screen, const struct sgl_resolution *req,
+      int *x, int *y, unsigned *width, unsigned *height)
+{
+   const struct randr_monitor *mon = randr_get_monitor(dpy, req->monitor_index);
+   if (!mon)
+      return false;
+
+   unsigned screen_width  = DisplayWidth(dpy, screen);
+   unsigned screen_height = DisplayHeight(dpy, screen);
+   unsigned desktop_mhz = g_randr.modes[mon->first_mode].refresh_mhz;
+
+   const struct randr_mode *best = NULL;
+   struct randr_score best_score = {0};
+   for (unsigned i = 0; i < mon->num_modes; i++)
+   {
+      const struct randr_mode *mode = &g_randr.modes[mon->first_mode + i];
+      if (mon->x + mode->width > screen_width || mon->y + mode->height > screen_height)
+         continue;
+
+      struct randr_score score = randr_score_mode(mode, req, desktop_mhz);
+      if (!best || randr_better(score, best_score))
+      {
+         best = mode;
+         best_score = score;
+      }
+   }
+
+   if (!best)
+      return false;
+
+   *x      = mon->x;
+   *y      = mon->y;
+   *width  = best->width;
+   *height = best->height;
+   g_randr.fullscreen = true;
+
+   if (best->id == mon->mode)
+      return true;
+
+   RRCrtc crtc_id = mon->crtc;
+   RRMode mode_id = best->id;
+   XRRScreenResources *res = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
+   XRRCrtcInfo *crtc = res ? XRRGetCrtcInfo(dpy, res, crtc_id) : NULL;
+   RROutput *outputs = crtc ? malloc(crtc->noutput * sizeof(*outputs)) : NULL;
+   bool ret = false;
+
+   if (outputs)
+   {
+      memcpy(outputs, crtc->outputs, crtc->noutput * sizeof(*outputs));
+      if (XRRSetCrtcConfig(dpy, res, crtc_id, CurrentTime, crtc->x, crtc->y, mode_id,
+               crtc->rotation, crtc->outputs, crtc->noutput) == RRSetConfigSuccess)
+      {
+         g_randr.saved.active      = true;
+         g_randr.saved.crtc        = crtc_id;
+         g_randr.saved.mode        = crtc->mode;
+         g_randr.saved.rotation    = crtc->rotation;
+         g_randr.saved.x           = crtc->x;
+         g_randr.saved.y           = crtc->y;
+         g_randr.saved.outputs     = outputs;
+         g_randr.saved.num_outputs = crtc->noutput;
+         outputs = NULL;
+         ret = true;
+      }
+      else
+         fprintf(stderr, "[SGL]: Failed to switch display mode.\n");
+   }
+
+   free(outputs);
+   if (crtc)
+      XRRFreeCrtcInfo(crtc);
+   if (res)
+      XRRFreeScreenResources(res);
+
+   // The current mode changed. Don't wait for the notify event.
+   randr_invalidate();
+   if (!ret)
+      g_randr.fullscreen = false;
+   return ret;
+}
+
+// Puts back the mode randr_set_fullscreen_mode() replaced.
+static void randr_restore_mode(void)
+{
+   if (g_randr.saved.active)
+   {
+      XRRScreenResources *res = XRRGetScreenResourcesCurrent(g_randr.dpy, DefaultRootWindow(g_randr.dpy));
+      if (res)
+      {
+         XRRSetCrtcConfig(g_randr.dpy, res, g_randr.saved.crtc, CurrentTime,
+               g_randr.saved.x, g_randr.saved.y, g_randr.saved.mode, g_randr.saved.rotation,
+               g_randr.saved.outputs, g_randr.saved.num_outputs);
+         XRRFreeScreenResources(res);
+      }
+      free(g_randr.saved.outputs);
+   }
+
+   memset(&g_randr.saved, 0, sizeof(g_randr.saved));
+   g_randr.fullscreen = false;
+   randr_invalidate();
+}
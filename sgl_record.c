@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Frame recorder. Included by the POSIX backends after sgl_capture.c.
+// The capture sink copies each frame into a free queue entry on the render thread.
+// Conversion and writes happen on the writer thread, which owns the entries between head and head + count.
+
+#include <pthread.h>
+
+#define RECORD_DEFAULT_QUEUE_SIZE 8
+
+struct record_frame
+{
+   uint8_t *data;
+   size_t size;
+   unsigned width;
+   unsigned height;
+};
+
+static struct
+{
+   bool active;
+   FILE *file;
+   int container;
+   int policy;
+
+   unsigned fps_num;
+   unsigned fps_den;
+   // Y4M can't change size mid-stream. Set by the first frame.
+   unsigned width;
+   unsigned height;
+   uint8_t *i420;
+
+   struct record_frame *queue;
+   unsigned capacity;
+   unsigned head;
+   unsigned count;
+   bool stop;
+
+   pthread_t thread;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   pthread_cond_t space;
+
+   uint64_t written;
+   uint64_t dropped;
+   uint64_t capture_dropped_base;
+} g_record;
+
+static bool record_write_y4m(const struct record_frame *frame)
+{
+   if (!g_record.width)
+   {
+      g_record.width = frame->width;
+      g_record.height = frame->height;
+
+      size_t chroma = (size_t)((frame->width + 1) / 2) * ((frame->height + 1) / 2);
+      g_record.i420 = malloc((size_t)frame->width * frame->height + 2 * chroma);
+      if (!g_record.i420)
+         return false;
+
+      fprintf(g_record.file, "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C420jpeg\n",
+            frame->width, frame->height, g_record.fps_num, g_record.fps_den);
+   }
+
+   if (frame->width != g_record.width || frame->height != g_record.height || !g_record.i420)
+      return false;
+
+   size_t luma = (size_t)frame->width * frame->height;
+   size_t chroma = (size_t)((frame->width + 1) / 2) * ((frame->height + 1) / 2);
+   pixel_rgba_to_i420(g_record.i420, g_record.i420 + luma, g_record.i420 + luma + chroma,
+         frame->data, (size_t)frame->width * 4, frame->width, frame->height);
+
+   return fputs("FRAME\n", g_record.file) >= 0 &&
+      fwrite(g_record.i420, 1, luma + 2 * chroma, g_record.file) == luma + 2 * chroma;
+}
+
+static bool record_write(const struct record_frame *frame)
+{
+   if (g_record.container == SGL_RECORD_Y4M)
+      return record_write_y4m(frame);
+
+   size_t size = (size_t)frame->width * frame->height * 4;
+   return fwrite(frame->data, 1, size, g_record.file) == size;
+}
+
+static void *record_thread(void *data)
+{
+   (void)data;
+
+   pthread_mutex_lock(&g_record.lock);
+   for (;;)
+   {
+      while (!g_record.count && !g_record.stop)
+         pthread_cond_wait(&g_record.cond, &g_record.lock);
+      if (!g_record.count)
+         break;
+
+      const struct record_frame *frame = &g_record.queue[g_record.head];
+      pthread_mutex_unlock(&g_record.lock);
+
+      bool ok = record_write(frame);
+
+      pthread_mutex_lock(&g_record.lock);
+      if (ok)
+         g_record.written++;
+      else
+         g_record.dropped++;
+
+      g_record.head = (g_record.head + 1) % g_record.capacity;
+      g_record.count--;
+      pthread_cond_signal(&g_record.space);
+   }
+   pthread_mutex_unlock(&g_record.lock);
+
+   return NULL;
+}
+
+static void record_frame(const struct capture_source *src)
+{
+   pthread_mutex_lock(&g_record.lock);
+   if (g_record.policy == SGL_RECORD_WAIT)
+   {
+      while (g_record.count == g_record.capacity)
+         pthread_cond_wait(&g_record.space, &g_record.lock);
+   }
+   else if (g_record.count == g_record.capacity)
+   {
+      g_record.dropped++;
+      pthread_mutex_unlock(&g_record.lock);
+      return;
+   }
+
+   // Only this thread appends, so the entry stays ours until count is bumped.
+   struct record_frame *frame = &g_record.queue[(g_record.head + g_record.count) % g_record.capacity];
+   pthread_mutex_unlock(&g_record.lock);
+
+   size_t size = (size_t)src->width * src->height * 4;
+   if (frame->size < size)
+   {
+      uint8_t *data = realloc(frame->data, size);
+      if (!data)
+      {
+         pthread_mutex_lock(&g_record.lock);
+         g_record.dropped++;
+         pthread_mutex_unlock(&g_record.lock);
+         return;
+      }
+
+      frame->data = data;
+      frame->size = size;
+   }
+
+   frame->width = src->width;
+   frame->height = src->height;
+   capture_convert(frame->data, src->width * 4, src, SGL_PIXEL_FORMAT_RGBA, true);
+
+   pthread_mutex_lock(&g_record.lock);
+   g_record.count++;
+   pthread_cond_signal(&g_record.cond);
+   pthread_mutex_unlock(&g_record.lock);
+}
+
+int sgl_start_recording(const char *path, const struct sgl_record_options *opts)
+{
+   const struct sgl_record_options defaults = {0};
+   if (!opts)
+      opts = &defaults;
+
+   sgl_stop_recording();
+
+   g_record.file = fopen(path, "wb");
+   if (!g_record.file)
+   {
+      fprintf(stderr, "[SGL]: Failed to open %s for recording.\n", path);
+      return SGL_ERROR;
+   }
+
+   g_record.container = opts->container;
+   g_record.policy    = opts->policy;
+   g_record.capacity  = opts->queue_size ? opts->queue_size : RECORD_DEFAULT_QUEUE_SIZE;
+   g_record.fps_num   = opts->fps_num;
+   g_record.fps_den   = opts->fps_den ? opts->fps_den : 1;
+   if (!g_record.fps_num && g_refresh_period)
+   {
+      g_record.fps_num = 1000000;
+      g_record.fps_den = g_refresh_period;
+   }
+   else if (!g_record.fps_num)
+      g_record.fps_num = 60;
+
+   g_record.queue = calloc(g_record.capacity, sizeof(*g_record.queue));
+   if (!g_record.queue)
+      goto error;
+
+   pthread_mutex_init(&g_record.lock, NULL);
+   pthread_cond_init(&g_record.cond, NULL);
+   pthread_cond_init(&g_record.space, NULL);
+   if (pthread_create(&g_record.thread, NULL, record_thread, NULL) != 0)
+   {
+      pthread_cond_destroy(&g_record.space);
+      pthread_cond_destroy(&g_record.cond);
+      pthread_mutex_destroy(&g_record.lock);
+      goto error;
+   }
+   g_record.active = true;
+
+   const struct sgl_capture_options capture_opts = {
+      .format = SGL_PIXEL_FORMAT_RGBA,
+   };
+
+   if (!capture_add_sink(record_frame, &capture_opts))
+   {
+      sgl_stop_recording();
+      return SGL_ERROR;
+   }
+
+   g_record.capture_dropped_base = g_capture.dropped;
+   return SGL_OK;
+
+error:
+   fclose(g_record.file);
+   free(g_record.queue);
+   memset(&g_record, 0, sizeof(g_record));
+   return SGL_ERROR;
+}
+
+void sgl_stop_recording(void)
+{
+   if (!g_record.active)
+      return;
+
+   capture_remove_sink(record_frame);
+
+   // The writer drains the queue before it exits.
+   pthread_mutex_lock(&g_record.lock);
+   g_record.stop = true;
+   pthread_cond_signal(&g_record.cond);
+   pthread_mutex_unlock(&g_record.lock);
+   pthread_join(g_record.thread, NULL);
+
+   pthread_cond_destroy(&g_record.space);
+   pthread_cond_destroy(&g_record.cond);
+   pthread_mutex_destroy(&g_record.lock);
+
+   fclose(g_record.file);
+   for (unsigned i = 0; i < g_record.capacity; i++)
+      free(g_record.queue[i].data);
+   free(g_record.queue);
+   free(g_record.i420);
+   memset(&g_record, 0, sizeof(g_record));
+}
+
+int sgl_get_record_stats(struct sgl_record_stats *stats)
+{
+   if (!g_record.active)
+      return SGL_ERROR;
+
+   pthread_mutex_lock(&g_record.lock);
+   stats->written = g_record.written;
+   stats->dropped = g_record.dropped;
+   stats->queued  = g_record.count;
+   pthread_mutex_unlock(&g_record.lock);
+
+   // Frames the capture ring had to skip were never seen by the recorder.
+   if (g_capture.active)
+      stats->dropped += g_capture.dropped - g_record.capture_dropped_base;
+   return SGL_OK;
+}
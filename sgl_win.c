@@ -24,6 +24,11 @@
 #include <stdio.h>
 #include <windowsx.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "sgl_profile.c"
+#include "sgl_gl.c"
+#include "sgl_capture.c"
 
 static HWND g_hwnd;
 static HGLRC g_hrc;
@@ -50,6 +55,18 @@ static int g_mouse_last_x;
 static int g_mouse_last_y;
 static BOOL g_mouse_delta_invalid;
 
+#define SGL_EVENT_QUEUE_SIZE 1024
+static struct sgl_event g_events[SGL_EVENT_QUEUE_SIZE];
+static unsigned g_num_events;
+static unsigned g_event_mask;
+
+static unsigned g_swap_interval;
+static struct sgl_frame_timing g_frame_history[SGL_FRAME_STATS_HISTORY];
+static uint64_t g_frame_count;
+static uint64_t g_missed_vblanks;
+static unsigned g_refresh_period;
+static double g_filter_interval;
+
 static void setup_pixel_format(HDC hdc)
 {
    int num_pixel_format;
@@ -173,6 +190,9 @@ static void create_gl_context(HWND hwnd)
 static void handle_key_press(WPARAM key, int pressed);
 static void handle_mouse_move(int x, int y);
 static void handle_mouse_press(UINT message, int x, int y);
+static void handle_focus(int focused);
+static BOOL wants_event(int type);
+static void queue_event(const struct sgl_event *ev);
 
 static LRESULT CALLBACK WndProc(HWND hwnd, UINT message,
       WPARAM wparam, LPARAM lparam)
@@ -207,6 +227,11 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message,
          handle_mouse_press(message, GET_X_LPARAM(lparam), GET_Y_LPARAM(lparam));
          return 0;
 
+      case WM_SETFOCUS:
+      case WM_KILLFOCUS:
+         handle_focus(message == WM_SETFOCUS);
+         return 0;
+
       case WM_CREATE:
          create_gl_context(hwnd);
          return 0;
@@ -243,9 +268,38 @@ static BOOL set_fullscreen(unsigned width, unsigned height)
    return ChangeDisplaySettings(&devmode, CDS_FULLSCREEN) == DISP_CHANGE_SUCCESSFUL;
 }
 
+static void init_frame_timing(void)
+{
+   DEVMODE devmode;
+   memset(&devmode, 0, sizeof(devmode));
+   devmode.dmSize = sizeof(DEVMODE);
+
+   memset(g_frame_history, 0, sizeof(g_frame_history));
+   g_frame_count = 0;
+   g_missed_vblanks = 0;
+   g_refresh_period = 0;
+   g_filter_interval = 0.0;
+
+   /* 0 and 1 mean hardware default refresh rate. */
+   if (EnumDisplaySettings(NULL, ENUM_CURRENT_SETTINGS, &devmode) && devmode.dmDisplayFrequency > 1)
+      g_refresh_period = 1000000 / devmode.dmDisplayFrequency;
+}
+
+static int64_t get_time_usec(void)
+{
+   static LARGE_INTEGER freq;
+   LARGE_INTEGER count;
+   if (!freq.QuadPart)
+      QueryPerformanceFrequency(&freq);
+
+   QueryPerformanceCounter(&count);
+   return count.QuadPart * 1000000 / freq.QuadPart;
+}
+
 struct sgl_resolution *sgl_get_desktop_modes(unsigned *num_modes)
 {
    RECT rect;
+   DEVMODE mode;
    struct sgl_resolution *sgl_modes = (struct sgl_resolution*)calloc(1, sizeof(*sgl_modes));
    if (!sgl_modes)
       return NULL;
@@ -255,10 +309,41 @@ struct sgl_resolution *sgl_get_desktop_modes(unsigned *num_modes)
    GetClientRect(GetDesktopWindow(), &rect);
    sgl_modes[0].width = rect.right - rect.left;
    sgl_modes[0].height = rect.bottom - rect.top;
+
+   /* 0 and 1 mean the hardware default rate. */
+   memset(&mode, 0, sizeof(mode));
+   mode.dmSize = sizeof(mode);
+   if (EnumDisplaySettings(NULL, ENUM_CURRENT_SETTINGS, &mode) && mode.dmDisplayFrequency > 1)
+      sgl_modes[0].refresh_mhz = mode.dmDisplayFrequency * 1000;
    return sgl_modes;
 }
 
-int sgl_init(const struct sgl_context_options *opts)
+/* Builds the extension set and the dispatch table. The context must be current. */
+static BOOL init_gl_loader(const struct sgl_context_options *opts)
+{
+   const char *(APIENTRY *get_extensions_arb)(HDC) =
+      (const char *(APIENTRY *)(HDC))sgl_get_proc_address("wglGetExtensionsStringARB");
+   const char *(APIENTRY *get_extensions_ext)(void) =
+      (const char *(APIENTRY *)(void))sgl_get_proc_address("wglGetExtensionsStringEXT");
+   const char *platform_exts = NULL;
+
+   if (get_extensions_arb)
+      platform_exts = get_extensions_arb(g_hdc);
+   else if (get_extensions_ext)
+      platform_exts = get_extensions_ext();
+
+   if (!gl_extensions_init(platform_exts) ||
+         !gl_dispatch_init(&g_gl_dispatch, opts->gl.procs, opts->gl.num_procs))
+   {
+      fprintf(stderr, "[SGL]: Failed to initialize GL loader.\n");
+      return FALSE;
+   }
+
+   g_gl_current = &g_gl_dispatch;
+   return TRUE;
+}
+
+static int sgl_init_wgl(const struct sgl_context_options *opts)
 {
    unsigned width, height;
    DWORD style;
@@ -270,6 +355,7 @@ int sgl_init(const struct sgl_context_options *opts)
 
    g_quit = FALSE;
    g_resized = FALSE;
+   g_num_events = 0;
 
    g_ctx_modern = opts->context.style == SGL_CONTEXT_MODERN;
    g_gl_major = opts->context.major;
@@ -352,16 +438,45 @@ int sgl_init(const struct sgl_context_options *opts)
       SetFocus(g_hwnd);
    }
 
-   sgl_set_swap_interval(opts->swap_interval);
+   if (!init_gl_loader(opts))
+   {
+      sgl_deinit();
+      return SGL_ERROR;
+   }
+
+   if (opts->present_mode != SGL_PRESENT_MODE_DEFAULT)
+      sgl_set_present_mode(opts->present_mode);
+   else
+      sgl_set_swap_interval(opts->swap_interval);
+   init_frame_timing();
 
    g_inited = TRUE;
    return SGL_OK;
 }
 
+int sgl_init(const struct sgl_context_options *opts)
+{
+   int ret;
+   PROFILE_BEGIN(profile_start);
+
+   profile_reset();
+   ret = sgl_init_wgl(opts);
+
+   PROFILE_END(SGL_PROFILE_INIT, profile_start);
+   return ret;
+}
+
 void sgl_deinit(void)
 {
+   BOOL was_inited = g_inited;
+   PROFILE_BEGIN(profile_start);
+
    g_inited = FALSE;
 
+   sgl_stop_capture();
+   gl_dispatch_free(&g_gl_dispatch);
+   gl_extensions_free();
+
    if (g_quit)
    {
       wglMakeCurrent(NULL, NULL);
@@ -374,6 +489,10 @@ void sgl_deinit(void)
    if (g_fullscreen)
       ChangeDisplaySettings(NULL, 0);
    g_fullscreen = FALSE;
+
+   PROFILE_END(SGL_PROFILE_DEINIT, profile_start);
+   if (was_inited)
+      profile_dump();
 }
 
 void sgl_set_window_title(const char *title)
@@ -383,30 +502,151 @@ void sgl_set_window_title(const char *title)
 
 int sgl_check_resize(unsigned *width, unsigned *height)
 {
+   int ret = SGL_FALSE;
+   PROFILE_BEGIN(profile_start);
+
    if (g_resized)
    {
       *width = g_resize_width;
       *height = g_resize_height;
       g_resized = FALSE;
-      return SGL_TRUE;
+      ret = SGL_TRUE;
    }
-   else
-      return SGL_FALSE;
+
+   PROFILE_END(SGL_PROFILE_RESIZE, profile_start);
+   return ret;
 }
 
-void sgl_set_swap_interval(unsigned interval)
+static BOOL set_interval(int interval)
 {
    static BOOL (APIENTRY *swap_interval)(int) = NULL;
    if (!swap_interval)
       swap_interval = (BOOL (APIENTRY *)(int))sgl_get_proc_address("wglSwapIntervalEXT");
 
-   if (swap_interval)
-      swap_interval(interval);
+   return swap_interval && swap_interval(interval);
+}
+
+static BOOL has_swap_control_tear(void)
+{
+   return gl_has_extension("WGL_EXT_swap_control_tear");
+}
+
+void sgl_set_swap_interval(unsigned interval)
+{
+   g_swap_interval = interval;
+   set_interval(interval);
+}
+
+/* Mailbox and emulated FIFO relaxed are not implemented on WGL. */
+int sgl_set_present_mode(int mode)
+{
+   switch (mode)
+   {
+      case SGL_PRESENT_MODE_IMMEDIATE:
+         if (!set_interval(0))
+            return SGL_PRESENT_MODE_DEFAULT;
+         g_swap_interval = 0;
+         return mode;
+
+      case SGL_PRESENT_MODE_FIFO_RELAXED:
+         if (has_swap_control_tear() && set_interval(-1))
+         {
+            g_swap_interval = 1;
+            return mode;
+         }
+         /* Fallthrough */
+
+      default:
+         if (!set_interval(1))
+            return SGL_PRESENT_MODE_DEFAULT;
+         g_swap_interval = 1;
+         return SGL_PRESENT_MODE_FIFO;
+   }
 }
 
 void sgl_swap_buffers(void)
 {
+   struct sgl_frame_timing *timing;
+   const struct sgl_frame_timing *prev;
+   int64_t begin;
+   RECT rect;
+   PROFILE_BEGIN(profile_start);
+
+   begin = get_time_usec();
+
+   GetClientRect(g_hwnd, &rect);
+   capture_frame(rect.right - rect.left, rect.bottom - rect.top, g_frame_count + 1, begin);
+   capture_pump();
+
    SwapBuffers(g_hdc);
+
+   g_frame_count++;
+   prev = &g_frame_history[(g_frame_count - 1) % SGL_FRAME_STATS_HISTORY];
+   timing = &g_frame_history[g_frame_count % SGL_FRAME_STATS_HISTORY];
+   memset(timing, 0, sizeof(*timing));
+   timing->sbc = g_frame_count;
+   timing->cpu_swap_begin = begin;
+   timing->cpu_swap_end = get_time_usec();
+   timing->ust = timing->cpu_swap_end;
+
+   if (g_frame_count > 1 && g_refresh_period && g_swap_interval)
+   {
+      uint64_t vblanks = (timing->cpu_swap_end - prev->cpu_swap_end + g_refresh_period / 2) / g_refresh_period;
+      if (vblanks > g_swap_interval)
+         g_missed_vblanks += vblanks - g_swap_interval;
+   }
+
+   /* Isolated hitches are not allowed to drag the estimate along. */
+   if (g_frame_count > 1)
+   {
+      double interval = (double)(timing->cpu_swap_end - prev->cpu_swap_end);
+      if (g_filter_interval <= 0.0)
+         g_filter_interval = interval;
+      else if (interval < 3.0 * g_filter_interval)
+         g_filter_interval += (interval - g_filter_interval) * 0.125;
+   }
+
+   PROFILE_END(SGL_PROFILE_SWAP, profile_start);
+}
+
+int sgl_predict_next_present(struct sgl_present_prediction *pred)
+{
+   double interval, predicted, now;
+   if (!g_inited || !g_frame_count)
+      return SGL_ERROR;
+
+   interval = g_filter_interval > 0.0 ? g_filter_interval : g_refresh_period;
+   if (interval <= 0.0)
+      return SGL_ERROR;
+
+   predicted = g_frame_history[g_frame_count % SGL_FRAME_STATS_HISTORY].ust + interval;
+   now = (double)get_time_usec();
+   if (predicted < now)
+      predicted += interval * (uint64_t)((now - predicted) / interval + 1.0);
+
+   pred->present_time = (int64_t)predicted;
+   pred->frame_interval = (unsigned)(interval + 0.5);
+   return SGL_OK;
+}
+
+int sgl_get_frame_stats(struct sgl_frame_stats *stats)
+{
+   unsigned i, num;
+   if (!g_inited)
+      return SGL_ERROR;
+
+   num = g_frame_count < SGL_FRAME_STATS_HISTORY ? (unsigned)g_frame_count : SGL_FRAME_STATS_HISTORY;
+
+   stats->source = SGL_TIMING_CPU;
+   stats->refresh_period = g_refresh_period;
+   stats->missed_vblanks = g_missed_vblanks;
+   stats->frames = g_frame_count;
+   stats->num_history = num;
+
+   for (i = 0; i < num; i++)
+      stats->history[i] = g_frame_history[(g_frame_count - num + 1 + i) % SGL_FRAME_STATS_HISTORY];
+
+   return SGL_OK;
 }
 
 int sgl_has_focus(void)
@@ -414,19 +654,20 @@ int sgl_has_focus(void)
    return GetFocus() == g_hwnd;
 }
 
-int sgl_is_alive(void)
+static void pump_events(void)
 {
    int old_x = g_mouse_last_x;
    int old_y = g_mouse_last_y;
-
    MSG msg;
+   PROFILE_BEGIN(profile_start);
+
    while (PeekMessage(&msg, g_hwnd, 0, 0, PM_REMOVE))
    {
       TranslateMessage(&msg);
       DispatchMessage(&msg);
    }
 
-   if (g_mouse_relative && g_input_cbs.mouse_move_cb)
+   if (g_mouse_relative && wants_event(SGL_EVENT_MOUSE_MOVE))
    {
       POINT p;
       GetCursorPos(&p);
@@ -436,7 +677,14 @@ int sgl_is_alive(void)
          int delta_x = p.x - old_x;
          int delta_y = p.y - old_y;
          if (delta_x || delta_y)
-            g_input_cbs.mouse_move_cb(delta_x, delta_y);
+         {
+            struct sgl_event ev = {0};
+            ev.type = SGL_EVENT_MOUSE_MOVE;
+            ev.x = delta_x;
+            ev.y = delta_y;
+            ev.timestamp = GetTickCount();
+            queue_event(&ev);
+         }
       }
       else
          g_mouse_delta_invalid = FALSE;
@@ -453,12 +701,250 @@ int sgl_is_alive(void)
       g_mouse_last_y = p.y;
    }
 
+   PROFILE_END(SGL_PROFILE_PUMP, profile_start);
+}
+
+/* Events without a matching callback are kept for sgl_poll_events(). */
+static void dispatch_events(void)
+{
+   unsigned i, kept = 0;
+   PROFILE_BEGIN(profile_start);
+
+   for (i = 0; i < g_num_events; i++)
+   {
+      const struct sgl_event *ev = &g_events[i];
+      switch (ev->type)
+      {
+         case SGL_EVENT_KEY:
+            if (g_input_cbs.key_cb)
+            {
+               PROFILE_INPUT(ev);
+               g_input_cbs.key_cb(ev->code, ev->pressed);
+               continue;
+            }
+            break;
+
+         case SGL_EVENT_MOUSE_BUTTON:
+            if (g_input_cbs.mouse_button_cb)
+            {
+               PROFILE_INPUT(ev);
+               g_input_cbs.mouse_button_cb(ev->code, ev->pressed, ev->x, ev->y);
+               continue;
+            }
+            break;
+
+         case SGL_EVENT_MOUSE_MOVE:
+            if (g_input_cbs.mouse_move_cb)
+            {
+               PROFILE_INPUT(ev);
+               g_input_cbs.mouse_move_cb(ev->x, ev->y);
+               continue;
+            }
+            break;
+
+         case SGL_EVENT_FOCUS:
+            if (g_input_cbs.focus_cb)
+            {
+               g_input_cbs.focus_cb(ev->pressed);
+               continue;
+            }
+            break;
+      }
+
+      g_events[kept++] = *ev;
+   }
+
+   g_num_events = kept;
+   PROFILE_END(SGL_PROFILE_DISPATCH, profile_start);
+}
+
+int sgl_is_alive(void)
+{
+   pump_events();
+   dispatch_events();
    return !g_quit;
 }
 
+unsigned sgl_poll_events(struct sgl_event *events, unsigned max_events)
+{
+   unsigned i, num;
+   pump_events();
+
+   num = g_num_events < max_events ? g_num_events : max_events;
+   for (i = 0; i < num; i++)
+      PROFILE_INPUT(&g_events[i]);
+
+   memcpy(events, g_events, num * sizeof(*events));
+   memmove(g_events, g_events + num, (g_num_events - num) * sizeof(*events));
+   g_num_events -= num;
+   return num;
+}
+
+int sgl_start_export(const struct sgl_export_options *opts)
+{
+   (void)opts;
+   return SGL_ERROR;
+}
+
+void sgl_stop_export(void)
+{
+}
+
+int sgl_start_recording(const char *path, const struct sgl_record_options *opts)
+{
+   (void)path;
+   (void)opts;
+   return SGL_ERROR;
+}
+
+void sgl_stop_recording(void)
+{
+}
+
+int sgl_get_record_stats(struct sgl_record_stats *stats)
+{
+   (void)stats;
+   return SGL_ERROR;
+}
+
+int sgl_get_init_timing(struct sgl_init_timing *timing)
+{
+   (void)timing;
+   return SGL_ERROR;
+}
+
+int sgl_start_input_recording(const char *path)
+{
+   (void)path;
+   return SGL_ERROR;
+}
+
+void sgl_stop_input_recording(void)
+{
+}
+
+int sgl_start_input_replay(const char *path, int mode)
+{
+   (void)path;
+   (void)mode;
+   return SGL_ERROR;
+}
+
+int sgl_is_replaying(void)
+{
+   return SGL_FALSE;
+}
+
+void sgl_stop_input_replay(void)
+{
+}
+
+struct sgl_shared_context *sgl_create_shared_context(void)
+{
+   return NULL;
+}
+
+int sgl_make_current_shared(struct sgl_shared_context *ctx)
+{
+   (void)ctx;
+   return SGL_ERROR;
+}
+
+void sgl_destroy_shared_context(struct sgl_shared_context *ctx)
+{
+   (void)ctx;
+}
+
+struct sgl_fence *sgl_fence_insert(void)
+{
+   return NULL;
+}
+
+void sgl_fence_wait_gpu(struct sgl_fence *fence)
+{
+   (void)fence;
+}
+
+int sgl_fence_wait(struct sgl_fence *fence, uint64_t timeout)
+{
+   (void)fence;
+   (void)timeout;
+   return SGL_TRUE;
+}
+
+void sgl_fence_delete(struct sgl_fence *fence)
+{
+   (void)fence;
+}
+
+/* Only the main window exists. */
+struct sgl_window *sgl_window_create(const struct sgl_window_options *opts)
+{
+   (void)opts;
+   return NULL;
+}
+
+void sgl_window_destroy(struct sgl_window *win)
+{
+   (void)win;
+}
+
+int sgl_window_make_current(struct sgl_window *win)
+{
+   (void)win;
+   g_gl_current = &g_gl_dispatch;
+   return wglMakeCurrent(g_hdc, g_hrc) ? SGL_OK : SGL_ERROR;
+}
+
+void sgl_window_swap_buffers(struct sgl_window *win)
+{
+   (void)win;
+   sgl_swap_buffers();
+}
+
+int sgl_window_check_resize(struct sgl_window *win, unsigned *width, unsigned *height)
+{
+   (void)win;
+   return sgl_check_resize(width, height);
+}
+
+void sgl_window_set_title(struct sgl_window *win, const char *title)
+{
+   (void)win;
+   sgl_set_window_title(title);
+}
+
+void sgl_window_set_input_callbacks(struct sgl_window *win, const struct sgl_input_callbacks *cbs)
+{
+   (void)win;
+   sgl_set_input_callbacks(cbs);
+}
+
+int sgl_window_has_focus(struct sgl_window *win)
+{
+   (void)win;
+   return sgl_has_focus();
+}
+
+int sgl_window_is_open(struct sgl_window *win)
+{
+   (void)win;
+   return !g_quit;
+}
+
+unsigned sgl_get_framebuffer(void)
+{
+   return 0;
+}
+
 sgl_function_t sgl_get_proc_address(const char *sym)
 {
-   return (sgl_function_t)wglGetProcAddress(sym);
+   /* wglGetProcAddress() only knows entry points beyond OpenGL 1.1,
+    * and some drivers return small integers instead of NULL. */
+   PROC proc = wglGetProcAddress(sym);
+   if ((INT_PTR)proc >= -1 && (INT_PTR)proc <= 3)
+      proc = GetProcAddress(GetModuleHandleA("opengl32.dll"), sym);
+   return (sgl_function_t)proc;
 }
 
 void sgl_get_handles(struct sgl_handles *handles)
@@ -473,6 +959,53 @@ void sgl_set_input_callbacks(const struct sgl_input_callbacks *cbs)
    g_input_cbs = *cbs;
 }
 
+void sgl_set_event_mask(unsigned mask)
+{
+   g_event_mask = mask;
+}
+
+int sgl_get_input_queue_stats(struct sgl_input_queue_stats *stats)
+{
+   (void)stats;
+   return SGL_ERROR;
+}
+
+int sgl_set_event_coalescing(int type, int policy)
+{
+   (void)type;
+   (void)policy;
+   return SGL_ERROR;
+}
+
+int sgl_set_key_repeat_filter(int enable)
+{
+   (void)enable;
+   return SGL_ERROR;
+}
+
+int sgl_get_input_filter_stats(struct sgl_input_filter_stats *stats)
+{
+   (void)stats;
+   return SGL_ERROR;
+}
+
+static BOOL wants_event(int type)
+{
+   unsigned mask = g_event_mask |
+      (g_input_cbs.key_cb ? SGL_EVENT_MASK(SGL_EVENT_KEY) : 0) |
+      (g_input_cbs.mouse_button_cb ? SGL_EVENT_MASK(SGL_EVENT_MOUSE_BUTTON) : 0) |
+      (g_input_cbs.mouse_move_cb ? SGL_EVENT_MASK(SGL_EVENT_MOUSE_MOVE) : 0) |
+      (g_input_cbs.focus_cb ? SGL_EVENT_MASK(SGL_EVENT_FOCUS) : 0);
+
+   return (mask & SGL_EVENT_MASK(type)) != 0;
+}
+
+static void queue_event(const struct sgl_event *ev)
+{
+   if (g_num_events < SGL_EVENT_QUEUE_SIZE)
+      g_events[g_num_events++] = *ev;
+}
+
 void sgl_set_mouse_mode(int capture, int relative, int visible)
 {
    static BOOL mouse_hidden = FALSE;
@@ -556,14 +1089,19 @@ static const struct key_map bind_map[] = {
 static void handle_key_press(WPARAM key, int pressed)
 {
    size_t i;
-   if (!g_input_cbs.key_cb)
+   if (!wants_event(SGL_EVENT_KEY))
       return;
 
    for (i = 0; i < sizeof(bind_map) / sizeof(bind_map[0]); i++)
    {
       if (bind_map[i].win == key)
       {
-         g_input_cbs.key_cb(bind_map[i].sglk, pressed);
+         struct sgl_event ev = {0};
+         ev.type = SGL_EVENT_KEY;
+         ev.pressed = pressed;
+         ev.code = bind_map[i].sglk;
+         ev.timestamp = GetMessageTime();
+         queue_event(&ev);
          return;
       }
    }
@@ -571,17 +1109,22 @@ static void handle_key_press(WPARAM key, int pressed)
 
 static void handle_mouse_move(int x, int y)
 {
-   if (!g_input_cbs.mouse_move_cb)
+   struct sgl_event ev = {0};
+   if (!wants_event(SGL_EVENT_MOUSE_MOVE) || g_mouse_relative)
       return;
 
-   if (!g_mouse_relative)
-      g_input_cbs.mouse_move_cb(x, y);
+   ev.type = SGL_EVENT_MOUSE_MOVE;
+   ev.x = x;
+   ev.y = y;
+   ev.timestamp = GetMessageTime();
+   queue_event(&ev);
 }
 
 static void handle_mouse_press(UINT message, int x, int y)
 {
    int pressed, button;
-   if (!g_input_cbs.mouse_button_cb)
+   struct sgl_event ev = {0};
+   if (!wants_event(SGL_EVENT_MOUSE_BUTTON))
       return;
 
    switch (message)
@@ -622,7 +1165,23 @@ static void handle_mouse_press(UINT message, int x, int y)
          button = 0;
    }
 
-   g_input_cbs.mouse_button_cb(button, pressed, x, y);
+   ev.type = SGL_EVENT_MOUSE_BUTTON;
+   ev.pressed = pressed;
+   ev.code = button;
+   ev.x = x;
+   ev.y = y;
+   ev.timestamp = GetMessageTime();
+   queue_event(&ev);
 }
 
+static void handle_focus(int focused)
+{
+   struct sgl_event ev = {0};
+   if (!wants_event(SGL_EVENT_FOCUS))
+      return;
 
+   ev.type = SGL_EVENT_FOCUS;
+   ev.pressed = focused;
+   ev.timestamp = GetMessageTime();
+   queue_event(&ev);
+}
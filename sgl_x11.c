@@ -19,13 +19,25 @@
 #include "sgl_keysym.h"
 
 #include <X11/extensions/xf86vmode.h>
+#ifdef SGL_HAVE_XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif
 #include <X11/keysym.h>
-
+#include <X11/XF86keysym.h>
+#include <X11/XKBlib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <stddef.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 static Display *g_dpy;
 static Window g_win;
@@ -42,6 +54,28 @@ static EGLDisplay g_egl_dpy;
 static bool g_inited;
 static bool g_is_double_buffered;
 
+// Headless contexts have no window and render to an FBO.
+static bool g_headless;
+static GLXPbuffer g_pbuffer;
+static GLuint g_fbo;
+static GLuint g_fbo_renderbuffers[2];
+static void (*g_pglDeleteFramebuffers)(GLsizei, const GLuint*);
+static void (*g_pglDeleteRenderbuffers)(GLsizei, const GLuint*);
+
+// Version the main modern context was created with. 0 until then.
+static unsigned g_ctx_major;
+static unsigned g_ctx_minor;
+
+// What sgl_create_shared_context() needs to create contexts like the main one.
+static bool g_shared_contexts;
+static struct sgl_context_options g_ctx_opts;
+static GLXFBConfig g_fbc;
+#ifdef SGL_HAVE_EGL
+static EGLConfig g_egl_config;
+static EGLenum g_egl_api;
+static EGLint g_egl_ctx_attribs[8];
+#endif
+
 static int g_last_width;
 static int g_last_height;
 static bool g_resized;
@@ -49,9 +83,18 @@ static bool g_resized;
 static Atom g_quit_atom;
 static volatile sig_atomic_t g_quit;
 static bool g_has_focus;
+static bool g_mapped;
+
+#define SGL_WINDOW_EVENT_MASK (StructureNotifyMask | FocusChangeMask)
 
 static XF86VidModeModeInfo g_desktop_mode;
+static bool g_have_desktop_mode;
 static bool g_should_reset_mode;
+static unsigned g_monitor_index;
+
+static struct sgl_init_timing g_init_timing;
+static int64_t g_init_mark;
+static int64_t get_time_usec(void);
 
 static struct sgl_input_callbacks g_input_cbs;
 static bool g_mouse_grabbed;
@@ -59,7 +102,176 @@ static bool g_mouse_relative;
 static int g_mouse_last_x;
 static int g_mouse_last_y;
 
+// Relative motion comes from XI_RawMotion instead of warping the pointer.
+// Written by the main thread, read by the input thread with __atomic builtins.
+static bool g_raw_motion;
+// Raw deltas travel as this internal type until handle_input() turns them into SGL_EVENT_MOUSE_MOVE.
+#define SGL_EVENT_RAW_MOTION 0xffff
+#ifdef SGL_HAVE_XINPUT2
+static struct
+{
+   Display *dpy;
+   bool available;
+   int opcode;
+   // Sub-pixel remainders. Only the thread reading dpy touches them.
+   double rem_x;
+   double rem_y;
+} g_xi2;
+#endif
+
+// Windows created with sgl_window_create(). They share the main window's context and display
+// connection, and their events are read by the same pump. Everything else is main window only.
+struct sgl_window
+{
+   Window win;
+   Colormap cmap;
+#ifdef SGL_HAVE_EGL
+   EGLSurface egl_surf;
+#endif
+   int width;
+   int height;
+   bool resized;
+   bool closed;
+   bool has_focus;
+   bool mapped;
+   struct sgl_input_callbacks cbs;
+   struct sgl_window *next;
+};
+static struct sgl_window *g_windows;
+
+static struct sgl_window *find_window(Window win);
+static void handle_window_event(struct sgl_window *win, const XEvent *event);
+static bool window_wants_event(const struct sgl_window *win, int type);
+static void select_input(void);
+
+#define SGL_EVENT_QUEUE_SIZE 1024
+#define SGL_MAX_INPUT_QUEUE_SIZE (1u << 20)
+static struct sgl_event g_events[SGL_EVENT_QUEUE_SIZE];
+static unsigned g_num_events;
+static unsigned g_event_mask;
+
+// Applied as events are queued, before dispatch.
+static struct
+{
+   // SGL_COALESCE_* per SGL_EVENT_* type.
+   int policy[SGL_EVENT_FOCUS + 1];
+   unsigned long long merged[SGL_EVENT_FOCUS + 1];
+
+   // With detectable autorepeat, repeats are presses of keys that are already down.
+   bool repeat_filter;
+   bool keys_down[SGLK_LAST];
+   unsigned long long repeats_dropped;
+} g_input_filter;
+static Time g_last_event_time;
+
+// Threaded input.
+struct input_ring
+{
+   struct sgl_event *events;
+   unsigned mask;
+   unsigned head;
+   unsigned tail;
+   unsigned high_water;
+   unsigned long long dropped;
+};
+
+static Display *g_input_dpy;
+static pthread_t g_input_thread;
+static bool g_input_thread_running;
+static bool g_input_thread_quit;
+static int g_input_wakeup[2] = { -1, -1 };
+static struct input_ring g_input_ring;
+
+static Display *input_display(void)
+{
+   return g_input_dpy ? g_input_dpy : g_dpy;
+}
+
+// Every connection the library opens goes through here. XInitThreads() has to
+// come before the first Xlib call, and whether threaded input or shared contexts
+// will be used isn't known yet when e.g. sgl_get_desktop_modes() runs first.
+// libX11 1.8 and later do this in XOpenDisplay() anyway.
+static Display *open_display(void)
+{
+   static bool threads_initialized;
+   if (!threads_initialized)
+   {
+      XInitThreads();
+      threads_initialized = true;
+   }
+
+   return XOpenDisplay(NULL);
+}
+
+static bool init_input_display(const struct sgl_context_options *opts);
+static bool start_input_thread(void);
+static void stop_input_thread(void);
+static void wake_input_thread(void);
+
+// Keycode -> SGLK_* translation, built from the server keyboard mapping.
+// The input thread keeps its own table, rebuilt on its own MappingNotify,
+// so neither thread ever reads a table the other one is writing.
+static unsigned short g_keycode_map[256];
+static unsigned short g_input_keycode_map[256];
+static void init_keycode_map(Display *dpy, unsigned short *map);
+static void init_focus(void);
+
 static int (*g_pglSwapInterval)(int);
+static void (*g_pglXSwapIntervalEXT)(Display*, GLXDrawable, int);
+static bool g_has_swap_control_tear;
+static unsigned g_swap_interval;
+
+// Present mode emulation.
+static int g_present_mode;
+static bool g_adaptive_vsync;
+static bool g_limit_frames;
+static int64_t g_last_swap_begin;
+
+// Consecutive frames needed before emulated relaxed FIFO changes the interval.
+#define ADAPTIVE_VSYNC_MISSED_FRAMES 2
+#define ADAPTIVE_VSYNC_ON_TIME_FRAMES 30
+static uint64_t g_adaptive_missed;
+static unsigned g_adaptive_streak;
+static GLsync g_frame_fence;
+static GLsync (*g_pglFenceSync)(GLenum, GLbitfield);
+static GLenum (*g_pglClientWaitSync)(GLsync, GLbitfield, GLuint64);
+static void (*g_pglDeleteSync)(GLsync);
+static void (*g_pglWaitSync)(GLsync, GLbitfield, GLuint64);
+static bool load_sync_procs(void);
+
+static bool has_glx_extension(const char *ext);
+static void init_present_mode(const struct sgl_context_options *opts);
+
+// Frame timing.
+static struct sgl_frame_timing g_frame_history[SGL_FRAME_STATS_HISTORY];
+static uint64_t g_frame_count;
+static uint64_t g_last_present_frame;
+static uint64_t g_last_present_msc;
+static uint64_t g_missed_vblanks;
+static int64_t g_sbc_base;
+static unsigned g_refresh_period;
+static int g_timing_source;
+static int g_swap_event_base;
+
+// Filtered history of presentation times, used for prediction.
+static uint64_t g_filter_frame;
+static int64_t g_filter_ust;
+static double g_filter_interval;
+
+static Bool (*g_pglXGetSyncValuesOML)(Display*, GLXDrawable, int64_t*, int64_t*, int64_t*);
+static Bool (*g_pglXGetMscRateOML)(Display*, GLXDrawable, int32_t*, int32_t*);
+static void init_frame_timing(void);
+
+#include "sgl_profile.c"
+#include "sgl_gl.c"
+#include "sgl_caps.c"
+#ifdef SGL_HAVE_XRANDR
+#include "sgl_randr.c"
+#endif
+#include "sgl_capture.c"
+#include "sgl_export.c"
+#include "sgl_record.c"
+#include "sgl_input_log.c"
 
 static void sighandler(int sig)
 {
@@ -67,11 +279,21 @@ static void sighandler(int sig)
    g_quit = 1;
 }
 
+static void catch_signals(void)
+{
+   struct sigaction sa = {
+      .sa_handler = sighandler,
+      .sa_flags = SA_RESTART,
+   };
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGINT, &sa, NULL);
+   sigaction(SIGTERM, &sa, NULL);
+}
+
 static Bool glx_wait_notify(Display *d, XEvent *e, char *arg)
 {
    (void)d;
-   (void)arg;
-   return (e->type == MapNotify) && (e->xmap.window == g_win);
+   return (e->type == MapNotify) && (e->xmap.window == *(const Window*)arg);
 }
 
 static void hide_mouse(void)
@@ -100,15 +322,49 @@ static void show_mouse(void)
    XUndefineCursor(g_dpy, g_win);
 }
 
+// Time spent since the last mark, added to a step of g_init_timing.
+static void init_timing_mark(unsigned *step)
+{
+   int64_t now = get_time_usec();
+   *step += now - g_init_mark;
+   g_init_mark = now;
+}
+
 static Atom XA_NET_WM_STATE;
 static Atom XA_NET_WM_STATE_FULLSCREEN;
-#define XA_INIT(x) XA##x = XInternAtom(g_dpy, #x, False)
 #define _NET_WM_STATE_ADD 1
-static void set_windowed_fullscreen(void)
+
+// Interns every atom init needs in one round trip.
+static void init_atoms(void)
+{
+   static const char *names[] = {
+      "WM_DELETE_WINDOW",
+      "_NET_WM_STATE",
+      "_NET_WM_STATE_FULLSCREEN",
+   };
+
+   Atom atoms[3];
+   if (!XInternAtoms(g_dpy, (char**)names, 3, False, atoms))
+      memset(atoms, 0, sizeof(atoms));
+
+   g_quit_atom                = atoms[0];
+   XA_NET_WM_STATE            = atoms[1];
+   XA_NET_WM_STATE_FULLSCREEN = atoms[2];
+}
+
+// Window managers ignore the creation position unless asked to honor it.
+static void set_window_position_hint(Window win, int x, int y)
 {
-   XA_INIT(_NET_WM_STATE);
-   XA_INIT(_NET_WM_STATE_FULLSCREEN);
+   XSizeHints hints = {
+      .flags = PPosition,
+      .x     = x,
+      .y     = y,
+   };
+   XSetWMNormalHints(g_dpy, win, &hints);
+}
 
+static void set_windowed_fullscreen(void)
+{
    if (!XA_NET_WM_STATE || !XA_NET_WM_STATE_FULLSCREEN)
    {
       fprintf(stderr, "[SGL]: GLX cannot set fullscreen :(\n");
@@ -134,53 +390,85 @@ static void set_windowed_fullscreen(void)
          &xev);
 }
 
+static unsigned mode_refresh_mhz(const XF86VidModeModeInfo *mode)
+{
+   if (!mode->htotal || !mode->vtotal)
+      return 0;
+
+   // dotclock is in kHz.
+   return (unsigned)((uint64_t)mode->dotclock * 1000000 / ((uint64_t)mode->htotal * mode->vtotal));
+}
+
 struct sgl_resolution *sgl_get_desktop_modes(unsigned *num_modes)
 {
-   XF86VidModeModeInfo **modes;
-   int mode_num;
-   Display *dpy = XOpenDisplay(NULL);
+#ifdef SGL_HAVE_XRANDR
+   struct sgl_resolution *randr_modes = randr_get_desktop_modes(num_modes);
+   if (randr_modes)
+      return randr_modes;
+#endif
+
+   XF86VidModeModeInfo **modes = NULL;
+   int mode_num = 0;
+   Display *dpy = g_dpy ? g_dpy : open_display();
    if (!dpy)
       return NULL;
 
-   XF86VidModeGetAllModeLines(dpy, DefaultScreen(dpy), &mode_num, &modes);
+   struct sgl_resolution *sgl_modes = NULL;
+   if (!XF86VidModeGetAllModeLines(dpy, DefaultScreen(dpy), &mode_num, &modes) || mode_num <= 0)
+      goto end;
 
-   struct sgl_resolution *sgl_modes = calloc(mode_num, sizeof(*sgl_modes));
+   sgl_modes = calloc(mode_num, sizeof(*sgl_modes));
    if (!sgl_modes)
-      goto error;
+      goto end;
 
    for (int i = 0; i < mode_num; i++)
    {
-      sgl_modes[i].width  = modes[i]->hdisplay;
-      sgl_modes[i].height = modes[i]->vdisplay;
+      sgl_modes[i].width       = modes[i]->hdisplay;
+      sgl_modes[i].height      = modes[i]->vdisplay;
+      sgl_modes[i].refresh_mhz = mode_refresh_mhz(modes[i]);
    }
 
-   XCloseDisplay(dpy);
-   XFree(modes);
-
    *num_modes = mode_num;
 
+end:
+   if (dpy != g_dpy)
+      XCloseDisplay(dpy);
+   if (modes)
+      XFree(modes);
    return sgl_modes;
-
-error:
-   XCloseDisplay(dpy);
-   XFree(modes);
-   return NULL;
 }
 
-static void set_desktop_mode(void)
+// Mode lines are only fetched when needed: for fullscreen, and for the refresh rate
+// if GLX_OML_sync_control can't provide it. The first mode is the current one.
+static const XF86VidModeModeInfo *get_desktop_mode(void)
 {
-   XF86VidModeModeInfo **modes;
-   int num_modes;
-   XF86VidModeGetAllModeLines(g_dpy, DefaultScreen(g_dpy), &num_modes, &modes);
-   g_desktop_mode = *modes[0];
-   XFree(modes);
+   if (!g_have_desktop_mode)
+   {
+      XF86VidModeModeInfo **modes;
+      int num_modes;
+      if (XF86VidModeGetAllModeLines(g_dpy, DefaultScreen(g_dpy), &num_modes, &modes) && num_modes > 0)
+      {
+         g_desktop_mode = *modes[0];
+         XFree(modes);
+      }
+      else
+         memset(&g_desktop_mode, 0, sizeof(g_desktop_mode));
+      g_have_desktop_mode = true;
+   }
+
+   return &g_desktop_mode;
 }
 
+// Also records the desktop mode, saving a second query.
 static bool get_video_mode(int width, int height, XF86VidModeModeInfo *mode)
 {
    XF86VidModeModeInfo **modes;
    int num_modes;
-   XF86VidModeGetAllModeLines(g_dpy, DefaultScreen(g_dpy), &num_modes, &modes);
+   if (!XF86VidModeGetAllModeLines(g_dpy, DefaultScreen(g_dpy), &num_modes, &modes) || num_modes <= 0)
+      return false;
+
+   g_desktop_mode = *modes[0];
+   g_have_desktop_mode = true;
 
    bool ret = false;
    for (int i = 0; i < num_modes; i++)
@@ -197,26 +485,333 @@ static bool get_video_mode(int width, int height, XF86VidModeModeInfo *mode)
    return ret;
 }
 
+// RandR picks a mode by size and refresh rate on the requested monitor.
+// XF86VidMode needs an exact size and only knows the default screen.
+static bool set_fullscreen_mode(const struct sgl_context_options *opts, int screen,
+      int *x, int *y, unsigned *width, unsigned *height)
+{
+#ifdef SGL_HAVE_XRANDR
+   if (randr_set_fullscreen_mode(g_dpy, screen, &opts->res, x, y, width, height))
+   {
+      g_should_reset_mode = true;
+      return true;
+   }
+#else
+   (void)opts;
+   (void)screen;
+   (void)x;
+   (void)y;
+#endif
+
+   XF86VidModeModeInfo mode;
+   if (!get_video_mode(*width, *height, &mode))
+      return false;
+
+   XF86VidModeSwitchToMode(g_dpy, DefaultScreen(g_dpy), &mode);
+   XF86VidModeSetViewPort(g_dpy, DefaultScreen(g_dpy), 0, 0);
+   g_should_reset_mode = true;
+   return true;
+}
+
+// Windows go on opts->res.monitor_index. Windowed fullscreen covers that monitor.
+// Returns true if the position should be passed on to the window manager.
+static bool get_window_rect(const struct sgl_context_options *opts, int screen,
+      int *x, int *y, unsigned *width, unsigned *height)
+{
+   bool windowed_fullscreen = opts->screen_type == SGL_SCREEN_WINDOWED_FULLSCREEN;
+   *x = 0;
+   *y = 0;
+   *width  = opts->res.width;
+   *height = opts->res.height;
+
+#ifdef SGL_HAVE_XRANDR
+   // Monitor 0 windows are left to the window manager, which saves querying RandR at init.
+   const struct randr_monitor *mon = NULL;
+   if (opts->res.monitor_index || windowed_fullscreen)
+      mon = randr_get_monitor(g_dpy, opts->res.monitor_index);
+   if (mon)
+   {
+      if (windowed_fullscreen)
+      {
+         *width  = mon->width;
+         *height = mon->height;
+      }
+
+      *x = mon->x + (*width < mon->width ? (int)(mon->width - *width) / 2 : 0);
+      *y = mon->y + (*height < mon->height ? (int)(mon->height - *height) / 2 : 0);
+      return true;
+   }
+#endif
+
+   if (windowed_fullscreen)
+   {
+      // Known from the connection setup, unlike the mode lines.
+      *width  = DisplayWidth(g_dpy, screen);
+      *height = DisplayHeight(g_dpy, screen);
+   }
+   return false;
+}
+
+// Builds the extension set and the main context's dispatch table. The context must be current.
+static bool init_gl_loader(const struct sgl_context_options *opts)
+{
+   const char *platform_exts = NULL;
+#ifdef SGL_HAVE_EGL
+   if (g_egl)
+      platform_exts = eglQueryString(g_egl_dpy, EGL_EXTENSIONS);
+   else
+#endif
+      platform_exts = glXQueryExtensionsString(g_dpy, DefaultScreen(g_dpy));
+
+   if (!gl_extensions_init(platform_exts) ||
+         !gl_dispatch_init(&g_gl_dispatch, opts->gl.procs, opts->gl.num_procs))
+   {
+      fprintf(stderr, "[SGL]: Failed to initialize GL loader.\n");
+      return false;
+   }
+
+   g_gl_current = &g_gl_dispatch;
+   return true;
+}
+
+static bool g_x_error;
+static int ignore_x_error(Display *dpy, XErrorEvent *event)
+{
+   (void)dpy;
+   (void)event;
+   g_x_error = true;
+   return 0;
+}
+
+static GLXContext (*g_pglXCreateContextAttribs)(Display*, GLXFBConfig, GLXContext, Bool, const int*);
+
+// Unsupported versions are reported with an X error, which would otherwise end the process.
+static GLXContext create_glx_context_version(GLXFBConfig fbc, GLXContext share, unsigned major, unsigned minor)
+{
+   if (!g_pglXCreateContextAttribs)
+      g_pglXCreateContextAttribs = (GLXContext (*)(Display*, GLXFBConfig, GLXContext, Bool, const int*))
+         glXGetProcAddress((const GLubyte *)"glXCreateContextAttribsARB");
+   if (!g_pglXCreateContextAttribs)
+   {
+      fprintf(stderr, "[SGL]: Failed to get glXCreateContextAttribsARB symbol!\n");
+      return NULL;
+   }
+
+   const int attribs[] = {
+      GLX_CONTEXT_MAJOR_VERSION_ARB, major,
+      GLX_CONTEXT_MINOR_VERSION_ARB, minor,
+      GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
+#ifdef DEBUG
+      GLX_CONTEXT_FLAGS_ARB, GLX_CONTEXT_DEBUG_BIT_ARB,
+#endif
+      None,
+   };
+
+   g_x_error = false;
+   int (*old_handler)(Display*, XErrorEvent*) = XSetErrorHandler(ignore_x_error);
+   GLXContext ctx = g_pglXCreateContextAttribs(g_dpy, fbc, share, true, attribs);
+   XSync(g_dpy, False);
+   XSetErrorHandler(old_handler);
+
+   if (ctx && g_x_error)
+   {
+      glXDestroyContext(g_dpy, ctx);
+      ctx = NULL;
+   }
+   return ctx;
+}
+
+// Versions tried, newest first, when context.min_major allows falling back.
+static const struct
+{
+   unsigned major;
+   unsigned minor;
+} g_glx_versions[] = {
+   { 4, 6 }, { 4, 5 }, { 4, 4 }, { 4, 3 }, { 4, 2 }, { 4, 1 }, { 4, 0 },
+   { 3, 3 }, { 3, 2 },
+};
+
+static bool version_less(unsigned major, unsigned minor, unsigned other_major, unsigned other_minor)
+{
+   return major < other_major || (major == other_major && minor < other_minor);
+}
+
+// Shared contexts and cache hits use the version that worked before.
+// Otherwise the requested version is tried, then older ones down to context.min_major/min_minor.
+static GLXContext create_glx_context(GLXFBConfig fbc, GLXContext share, const struct sgl_context_options *opts)
+{
+   GLXContext ctx = NULL;
+   if (opts->context.style == SGL_CONTEXT_MODERN)
+   {
+      if (g_ctx_major)
+         ctx = create_glx_context_version(fbc, share, g_ctx_major, g_ctx_minor);
+
+      if (!ctx && !share)
+      {
+         unsigned min_major = opts->context.min_major;
+         unsigned min_minor = opts->context.min_minor;
+         if (!min_major)
+         {
+            min_major = opts->context.major;
+            min_minor = opts->context.minor;
+         }
+
+         g_ctx_major = opts->context.major;
+         g_ctx_minor = opts->context.minor;
+         ctx = create_glx_context_version(fbc, share, g_ctx_major, g_ctx_minor);
+
+         for (unsigned i = 0; !ctx && i < sizeof(g_glx_versions) / sizeof(g_glx_versions[0]); i++)
+         {
+            unsigned major = g_glx_versions[i].major;
+            unsigned minor = g_glx_versions[i].minor;
+            if (!version_less(major, minor, opts->context.major, opts->context.minor))
+               continue;
+            if (version_less(major, minor, min_major, min_minor))
+               break;
+
+            g_ctx_major = major;
+            g_ctx_minor = minor;
+            ctx = create_glx_context_version(fbc, share, major, minor);
+         }
+
+         if (!ctx)
+            g_ctx_major = g_ctx_minor = 0;
+      }
+   }
+   else
+      ctx = glXCreateNewContext(g_dpy, fbc, GLX_RGBA_TYPE, share, True);
+
+   if (!ctx)
+      fprintf(stderr, "[SGL]: Failed to create GLX context.\n");
+   return ctx;
+}
+
+// Identifies the display, driver and the options that affect what init settles on.
+// All of it is known without a round trip.
+static uint32_t glx_caps_key(const struct sgl_context_options *opts)
+{
+   uint32_t key = 2166136261u;
+   key = caps_hash(key, DisplayString(g_dpy));
+   key = caps_hash(key, ServerVendor(g_dpy));
+   key = caps_hash_uint(key, VendorRelease(g_dpy));
+   key = caps_hash_uint(key, DefaultScreen(g_dpy));
+   key = caps_hash(key, glXGetClientString(g_dpy, GLX_VENDOR));
+   key = caps_hash(key, glXGetClientString(g_dpy, GLX_VERSION));
+   key = caps_hash_uint(key, opts->context.style);
+   key = caps_hash_uint(key, opts->context.major);
+   key = caps_hash_uint(key, opts->context.minor);
+   key = caps_hash_uint(key, opts->context.min_major);
+   key = caps_hash_uint(key, opts->context.min_minor);
+   key = caps_hash_uint(key, opts->samples);
+   return key;
+}
+
+static uint32_t glx_caps_renderer(void)
+{
+   uint32_t hash = 2166136261u;
+   hash = caps_hash(hash, (const char*)glGetString(GL_VENDOR));
+   hash = caps_hash(hash, (const char*)glGetString(GL_RENDERER));
+   hash = caps_hash(hash, (const char*)glGetString(GL_VERSION));
+   return hash;
+}
+
+// glXChooseFBConfig() ignores every other attribute when given GLX_FBCONFIG_ID, so a cached ID is
+// checked against what the full match asks for. Sizes are minimums, bitmasks must be covered and
+// the rest must be equal. Answered from libGL's FBConfig cache, without round trips.
+static bool fbconfig_matches(GLXFBConfig fbc, const int *attribs, unsigned samples)
+{
+   int value;
+   for (; attribs[0] != None; attribs += 2)
+   {
+      if (glXGetFBConfigAttrib(g_dpy, fbc, attribs[0], &value) != Success)
+         return false;
+
+      switch (attribs[0])
+      {
+         case GLX_DRAWABLE_TYPE:
+         case GLX_RENDER_TYPE:
+            if ((value & attribs[1]) != attribs[1])
+               return false;
+            break;
+
+         case GLX_RED_SIZE:
+         case GLX_GREEN_SIZE:
+         case GLX_BLUE_SIZE:
+         case GLX_ALPHA_SIZE:
+         case GLX_DEPTH_SIZE:
+         case GLX_STENCIL_SIZE:
+         case GLX_SAMPLES:
+            if (value < attribs[1])
+               return false;
+            break;
+
+         default:
+            if (value != attribs[1])
+               return false;
+            break;
+      }
+   }
+
+   // The full match wouldn't pick a multisampled config if none was asked for.
+   if (!samples && (glXGetFBConfigAttrib(g_dpy, fbc, GLX_SAMPLE_BUFFERS, &value) != Success || value))
+      return false;
+   return true;
+}
+
+static unsigned probe_swap_caps(void)
+{
+   unsigned caps = 0;
+   if (glXGetProcAddress((const GLubyte*)"glXSwapIntervalSGI"))
+      caps |= CAPS_SWAP_SGI;
+   else if (glXGetProcAddress((const GLubyte*)"glXSwapIntervalMESA"))
+      caps |= CAPS_SWAP_MESA;
+
+   // Only EXT_swap_control can express late-swap tearing.
+   if (has_glx_extension("GLX_EXT_swap_control"))
+      caps |= CAPS_SWAP_EXT;
+   if ((caps & CAPS_SWAP_EXT) && has_glx_extension("GLX_EXT_swap_control_tear"))
+      caps |= CAPS_SWAP_TEAR;
+   return caps;
+}
+
+static void load_swap_procs(unsigned caps)
+{
+   g_pglSwapInterval = NULL;
+   if (caps & CAPS_SWAP_SGI)
+      g_pglSwapInterval = (int (*)(int))glXGetProcAddress((const GLubyte*)"glXSwapIntervalSGI");
+   else if (caps & CAPS_SWAP_MESA)
+      g_pglSwapInterval = (int (*)(int))glXGetProcAddress((const GLubyte*)"glXSwapIntervalMESA");
+
+   g_pglXSwapIntervalEXT = NULL;
+   if (caps & CAPS_SWAP_EXT)
+      g_pglXSwapIntervalEXT = (void (*)(Display*, GLXDrawable, int))glXGetProcAddress((const GLubyte*)"glXSwapIntervalEXT");
+   g_has_swap_control_tear = g_pglXSwapIntervalEXT && (caps & CAPS_SWAP_TEAR);
+}
+
 int sgl_init_glx(const struct sgl_context_options *opts)
 {
    if (g_inited)
       return SGL_ERROR;
 
-   g_quit      = 0;
-   g_has_focus = true;
-   g_resized   = false;
+   g_quit       = 0;
+   g_has_focus  = false;
+   g_mapped     = false;
+   g_resized    = false;
+   g_num_events = 0;
 
-   g_dpy = XOpenDisplay(NULL);
+   g_dpy = open_display();
    if (!g_dpy)
       goto error;
 
-   // Need GLX 1.3+.
-   int major, minor;
-   glXQueryVersion(g_dpy, &major, &minor);
-   if (major < 1 || (major == 1 && minor < 3))
+   if (!init_input_display(opts))
       goto error;
+   init_timing_mark(&g_init_timing.connect);
 
-   // Initialize FBConfig and XVisuals.
+   struct caps_entry cached;
+   uint32_t caps_key = glx_caps_key(opts);
+   bool have_caps = caps_load(caps_key, &cached);
+
+   // Initialize FBConfig and XVisuals. Needs GLX 1.3+, so no separate version query.
    const int visual_attribs[] = {
       GLX_X_RENDERABLE     , True,
       GLX_DRAWABLE_TYPE    , GLX_WINDOW_BIT,
@@ -234,9 +829,26 @@ int sgl_init_glx(const struct sgl_context_options *opts)
       None
    };
 
+   const int cached_attribs[] = {
+      GLX_FBCONFIG_ID, have_caps ? cached.fbconfig_id : 0,
+      None
+   };
+
+   // A cached config ID is matched directly instead of sorting every config.
    int nelements;
-   GLXFBConfig *fbc_temp = glXChooseFBConfig(g_dpy, DefaultScreen(g_dpy),
-         visual_attribs, &nelements);
+   GLXFBConfig *fbc_temp = NULL;
+   if (have_caps)
+      fbc_temp = glXChooseFBConfig(g_dpy, DefaultScreen(g_dpy), cached_attribs, &nelements);
+   if (fbc_temp && !fbconfig_matches(fbc_temp[0], visual_attribs, opts->samples))
+   {
+      XFree(fbc_temp);
+      fbc_temp = NULL;
+   }
+   if (!fbc_temp)
+   {
+      have_caps = false;
+      fbc_temp = glXChooseFBConfig(g_dpy, DefaultScreen(g_dpy), visual_attribs, &nelements);
+   }
 
    if (!fbc_temp)
       goto error;
@@ -247,6 +859,7 @@ int sgl_init_glx(const struct sgl_context_options *opts)
    XVisualInfo *vi = glXGetVisualFromFBConfig(g_dpy, fbc);
    if (!vi)
       goto error;
+   init_timing_mark(&g_init_timing.config);
 
    // Create Window.
    bool fullscreen = opts->screen_type == SGL_SCREEN_FULLSCREEN;
@@ -254,48 +867,43 @@ int sgl_init_glx(const struct sgl_context_options *opts)
    XSetWindowAttributes swa = {
       .colormap          = g_cmap = XCreateColormap(g_dpy, RootWindow(g_dpy, vi->screen), vi->visual, AllocNone),
       .border_pixel      = 0,
-      .event_mask        = StructureNotifyMask,
+      .event_mask        = SGL_WINDOW_EVENT_MASK,
       .override_redirect = fullscreen ? True : False,
    };
 
+   int x = 0, y = 0;
    unsigned width  = opts->res.width;
    unsigned height = opts->res.height;
-
-   set_desktop_mode();
+   bool positioned = false;
 
    if (fullscreen)
    {
-      XF86VidModeModeInfo mode;
-      if (get_video_mode(width, height, &mode))
-      {
-         XF86VidModeSwitchToMode(g_dpy, DefaultScreen(g_dpy), &mode);
-         XF86VidModeSetViewPort(g_dpy, DefaultScreen(g_dpy), 0, 0);
-         g_should_reset_mode = true;
-      }
-      else
+      if (!set_fullscreen_mode(opts, vi->screen, &x, &y, &width, &height))
          goto error;
    }
-   else if (opts->screen_type == SGL_SCREEN_WINDOWED_FULLSCREEN)
-   {
-      width  = g_desktop_mode.hdisplay;
-      height = g_desktop_mode.vdisplay;
-   }
+   else
+      positioned = get_window_rect(opts, vi->screen, &x, &y, &width, &height);
 
    g_win = XCreateWindow(g_dpy, RootWindow(g_dpy, vi->screen),
-         0, 0, width, height, 0,
+         x, y, width, height, 0,
          vi->depth, InputOutput, vi->visual, 
          CWBorderPixel | CWColormap | CWEventMask | (fullscreen ? CWOverrideRedirect : 0), &swa);
    XSetWindowBackground(g_dpy, g_win, 0);
+   if (positioned)
+      set_window_position_hint(g_win, x, y);
+   init_atoms();
 
-   g_last_width  = opts->res.width;
-   g_last_height = opts->res.height;
+   // The size the window was actually created with. Reported as a resize if it isn't the requested one.
+   g_last_width  = width;
+   g_last_height = height;
+   g_resized     = width != opts->res.width || height != opts->res.height;
 
    sgl_set_window_title(opts->title);
 
    if (fullscreen)
    {
       XMapRaised(g_dpy, g_win);
-      XGrabKeyboard(g_dpy, g_win, True, GrabModeAsync, GrabModeAsync, CurrentTime);
+      XGrabKeyboard(input_display(), g_win, True, GrabModeAsync, GrabModeAsync, CurrentTime);
    }
    else
       XMapWindow(g_dpy, g_win);
@@ -303,75 +911,71 @@ int sgl_init_glx(const struct sgl_context_options *opts)
    if (opts->screen_type == SGL_SCREEN_WINDOWED_FULLSCREEN)
       set_windowed_fullscreen();
 
-   g_quit_atom = XInternAtom(g_dpy, "WM_DELETE_WINDOW", False);
    if (g_quit_atom)
       XSetWMProtocols(g_dpy, g_win, &g_quit_atom, 1);
 
-   // Catch signals.
-   struct sigaction sa = {
-      .sa_handler = sighandler,
-      .sa_flags = SA_RESTART,
-   };
-   sigemptyset(&sa.sa_mask);
-   sigaction(SIGINT, &sa, NULL);
-   sigaction(SIGTERM, &sa, NULL);
+   init_keycode_map(g_dpy, g_keycode_map);
 
-   XEvent event;
-   XIfEvent(g_dpy, &event, glx_wait_notify, NULL);
+   catch_signals();
+   init_timing_mark(&g_init_timing.window);
 
-   // Create context.
-   if (opts->context.style == SGL_CONTEXT_MODERN)
+   // Create the context while the window manager maps the window.
+   if (have_caps)
    {
-      typedef GLXContext (*ContextProc)(Display*, GLXFBConfig,
-            GLXContext, Bool, const int *);
-
-      ContextProc proc = (ContextProc)glXGetProcAddress((const GLubyte *)"glXCreateContextAttribsARB");
-      if (!proc)
-      {
-         fprintf(stderr, "[SGL]: Failed to get glXCreateContextAttribsARB symbol!\n");
-         goto error;
-      }
-
-      const int attribs[] = {
-         GLX_CONTEXT_MAJOR_VERSION_ARB, opts->context.major,
-         GLX_CONTEXT_MINOR_VERSION_ARB, opts->context.minor,
-         GLX_CONTEXT_PROFILE_MASK_ARB, GLX_CONTEXT_CORE_PROFILE_BIT_ARB,
-#ifdef DEBUG
-         GLX_CONTEXT_FLAGS_ARB, GLX_CONTEXT_DEBUG_BIT_ARB,
-#endif
-         None,
-      };
-
-      g_ctx = proc(g_dpy, fbc, 0, true, attribs);
+      g_ctx_major = cached.major;
+      g_ctx_minor = cached.minor;
    }
-   else
-      g_ctx = glXCreateNewContext(g_dpy, fbc, GLX_RGBA_TYPE, 0, True);
-
+   g_ctx = create_glx_context(fbc, NULL, opts);
    if (!g_ctx)
-   {
-      fprintf(stderr, "[SGL]: Failed to create GLX context.\n");
       goto error;
-   }
+   g_fbc = fbc;
    
    glXMakeCurrent(g_dpy, g_win, g_ctx);
-   XSync(g_dpy, False);
 
-   int val;
-   glXGetConfig(g_dpy, vi, GLX_DOUBLEBUFFER, &val);
+   if (!init_gl_loader(opts))
+      goto error;
+   init_timing_mark(&g_init_timing.context);
+
+   XEvent event;
+   XIfEvent(g_dpy, &event, glx_wait_notify, (char*)&g_win);
+   init_focus();
+   init_timing_mark(&g_init_timing.map);
+
+   // Answered from libGL's FBConfig cache, unlike glXGetConfig().
+   int val = 0;
+   glXGetFBConfigAttrib(g_dpy, fbc, GLX_DOUBLEBUFFER, &val);
 
    g_is_double_buffered = val;
+
+   // A different renderer may have different capabilities, so they are probed again.
+   uint32_t renderer = glx_caps_renderer();
+   bool caps_valid = have_caps && renderer == cached.renderer;
+
+   struct caps_entry entry = {
+      .key      = caps_key,
+      .renderer = renderer,
+      .major    = g_ctx_major,
+      .minor    = g_ctx_minor,
+      .caps     = caps_valid ? cached.caps : probe_swap_caps(),
+   };
+   glXGetFBConfigAttrib(g_dpy, fbc, GLX_FBCONFIG_ID, &entry.fbconfig_id);
+
    if (g_is_double_buffered)
-   {
-      if (!g_pglSwapInterval)
-         g_pglSwapInterval = (int (*)(int))glXGetProcAddress((const GLubyte*)"glXSwapIntervalSGI");
-      if (!g_pglSwapInterval)
-         g_pglSwapInterval = (int (*)(int))glXGetProcAddress((const GLubyte*)"glXSwapIntervalMESA");
-      if (g_pglSwapInterval)
-         g_pglSwapInterval(opts->swap_interval);
-   }
+      load_swap_procs(entry.caps);
    else
       fprintf(stderr, "[SGL]: GLX is not double buffered!\n");
 
+   if (!caps_valid || entry.major != cached.major ||
+         entry.minor != cached.minor || entry.fbconfig_id != cached.fbconfig_id)
+      caps_store(&entry);
+
+   init_frame_timing();
+   init_present_mode(opts);
+
+   if (!start_input_thread())
+      goto error;
+   init_timing_mark(&g_init_timing.setup);
+
    g_inited = true;
    return SGL_OK;
    
@@ -381,19 +985,48 @@ error:
 }
 
 #ifdef SGL_HAVE_EGL
+// Context attributes for opts, kept in g_egl_ctx_attribs for shared contexts. NULL for defaults.
+static const EGLint *init_egl_ctx_attribs(const struct sgl_context_options *opts)
+{
+   EGLint *attr = g_egl_ctx_attribs;
+   if (opts->context.style == SGL_CONTEXT_GLES)
+   {
+      *attr++ = EGL_CONTEXT_CLIENT_VERSION;
+      *attr++ = opts->context.major;
+   }
+   else if (opts->context.style == SGL_CONTEXT_MODERN)
+   {
+      *attr++ = EGL_CONTEXT_MAJOR_VERSION_KHR;
+      *attr++ = opts->context.major;
+      *attr++ = EGL_CONTEXT_MINOR_VERSION_KHR;
+      *attr++ = opts->context.minor;
+      *attr++ = EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR;
+      *attr++ = EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR;
+   }
+   *attr = EGL_NONE;
+
+   return attr == g_egl_ctx_attribs ? NULL : g_egl_ctx_attribs;
+}
+
 int sgl_init_egl(const struct sgl_context_options *opts)
 {
    if (g_inited)
       return SGL_ERROR;
 
-   g_quit      = 0;
-   g_has_focus = true;
-   g_resized   = false;
+   g_quit       = 0;
+   g_has_focus  = false;
+   g_mapped     = false;
+   g_resized    = false;
+   g_num_events = 0;
 
-   g_dpy = XOpenDisplay(NULL);
+   g_dpy = open_display();
    if (!g_dpy)
       goto error;
 
+   if (!init_input_display(opts))
+      goto error;
+   init_timing_mark(&g_init_timing.connect);
+
    EGLConfig config;
    EGLint num_configs, egl_major, egl_minor;
 
@@ -419,11 +1052,6 @@ int sgl_init_egl(const struct sgl_context_options *opts)
       EGL_NONE,
    };
 
-   const EGLint egl_ctx_attribs[] = {
-      EGL_CONTEXT_CLIENT_VERSION, opts->context.major,
-      EGL_NONE,
-   };
-
    if (!eglChooseConfig(g_egl_dpy, egl_attribs, &config, 1, &num_configs)
          || num_configs == 0 || !config)
    {
@@ -446,6 +1074,7 @@ int sgl_init_egl(const struct sgl_context_options *opts)
       fprintf(stderr, "[SGL]: XGetVisualInfo() failed.\n");
       goto error;
    }
+   init_timing_mark(&g_init_timing.config);
 
    // Create Window.
    bool fullscreen = opts->screen_type == SGL_SCREEN_FULLSCREEN;
@@ -453,47 +1082,44 @@ int sgl_init_egl(const struct sgl_context_options *opts)
    XSetWindowAttributes swa = {
       .colormap          = g_cmap = XCreateColormap(g_dpy, RootWindow(g_dpy, vi->screen), vi->visual, AllocNone),
       .border_pixel      = 0,
-      .event_mask        = StructureNotifyMask,
+      .event_mask        = SGL_WINDOW_EVENT_MASK,
       .override_redirect = fullscreen ? True : False,
    };
 
+   int x = 0, y = 0;
    unsigned width  = opts->res.width;
    unsigned height = opts->res.height;
-
-   set_desktop_mode();
+   bool positioned = false;
 
    if (fullscreen)
    {
-      XF86VidModeModeInfo mode;
-      if (get_video_mode(width, height, &mode))
-      {
-         XF86VidModeSwitchToMode(g_dpy, DefaultScreen(g_dpy), &mode);
-         XF86VidModeSetViewPort(g_dpy, DefaultScreen(g_dpy), 0, 0);
-         g_should_reset_mode = true;
-      }
-      else
+      if (!set_fullscreen_mode(opts, vi->screen, &x, &y, &width, &height))
          goto error;
    }
-   else if (opts->screen_type == SGL_SCREEN_WINDOWED_FULLSCREEN)
-   {
-      width  = g_desktop_mode.hdisplay;
-      height = g_desktop_mode.vdisplay;
-   }
+   else
+      positioned = get_window_rect(opts, vi->screen, &x, &y, &width, &height);
 
    // Create window.
    g_win = XCreateWindow(g_dpy, RootWindow(g_dpy, vi->screen),
-         0, 0, width, height, 0,
+         x, y, width, height, 0,
          vi->depth, InputOutput, vi->visual, 
          CWBorderPixel | CWColormap | CWEventMask | (fullscreen ? CWOverrideRedirect : 0), &swa);
    XSetWindowBackground(g_dpy, g_win, 0);
+   if (positioned)
+      set_window_position_hint(g_win, x, y);
+   init_atoms();
+   init_timing_mark(&g_init_timing.window);
 
-   eglBindAPI(opts->context.major == 2 ? EGL_OPENGL_ES2_BIT : EGL_OPENGL_ES_BIT);
+   g_egl_api = EGL_OPENGL_ES_API;
+   eglBindAPI(g_egl_api);
 
-   g_last_width  = opts->res.width;
-   g_last_height = opts->res.height;
+   g_last_width  = width;
+   g_last_height = height;
+   g_resized     = width != opts->res.width || height != opts->res.height;
 
    // Create context.
-   g_egl_ctx = eglCreateContext(g_egl_dpy, config, EGL_NO_CONTEXT, egl_ctx_attribs);
+   g_egl_ctx = eglCreateContext(g_egl_dpy, config, EGL_NO_CONTEXT, init_egl_ctx_attribs(opts));
+   g_egl_config = config;
 
    if (!g_egl_ctx)
    {
@@ -507,6 +1133,7 @@ int sgl_init_egl(const struct sgl_context_options *opts)
       fprintf(stderr, "[SGL]: Failed to create EGL surface.\n");
       goto error;
    }
+   init_timing_mark(&g_init_timing.context);
 
    // Set up window.
    sgl_set_window_title(opts->title);
@@ -514,7 +1141,7 @@ int sgl_init_egl(const struct sgl_context_options *opts)
    if (fullscreen)
    {
       XMapRaised(g_dpy, g_win);
-      XGrabKeyboard(g_dpy, g_win, True, GrabModeAsync, GrabModeAsync, CurrentTime);
+      XGrabKeyboard(input_display(), g_win, True, GrabModeAsync, GrabModeAsync, CurrentTime);
    }
    else
       XMapWindow(g_dpy, g_win);
@@ -522,23 +1149,15 @@ int sgl_init_egl(const struct sgl_context_options *opts)
    if (opts->screen_type == SGL_SCREEN_WINDOWED_FULLSCREEN)
       set_windowed_fullscreen();
 
-   g_quit_atom = XInternAtom(g_dpy, "WM_DELETE_WINDOW", False);
    if (g_quit_atom)
       XSetWMProtocols(g_dpy, g_win, &g_quit_atom, 1);
 
-   // Catch signals.
-   struct sigaction sa = {
-      .sa_handler = sighandler,
-      .sa_flags = SA_RESTART,
-   };
-   sigemptyset(&sa.sa_mask);
-   sigaction(SIGINT, &sa, NULL);
-   sigaction(SIGTERM, &sa, NULL);
+   init_keycode_map(g_dpy, g_keycode_map);
 
-   XEvent event;
-   XIfEvent(g_dpy, &event, glx_wait_notify, NULL);
+   catch_signals();
+   init_timing_mark(&g_init_timing.window);
 
-   // Bind context.
+   // Bind the context while the window manager maps the window.
    if (!eglMakeCurrent(g_egl_dpy, g_egl_surf, g_egl_surf, g_egl_ctx))
    {
       fprintf(stderr, "[SGL]: Failed to make EGL context current.\n");
@@ -548,7 +1167,21 @@ int sgl_init_egl(const struct sgl_context_options *opts)
    XFree(vi);
 
    g_egl = true;
-   eglSwapInterval(g_egl_dpy, opts->swap_interval);
+   if (!init_gl_loader(opts))
+      goto error;
+   init_timing_mark(&g_init_timing.context);
+
+   XEvent event;
+   XIfEvent(g_dpy, &event, glx_wait_notify, (char*)&g_win);
+   init_focus();
+   init_timing_mark(&g_init_timing.map);
+
+   init_frame_timing();
+   init_present_mode(opts);
+
+   if (!start_input_thread())
+      goto error;
+   init_timing_mark(&g_init_timing.setup);
 
    g_inited = true;
    return SGL_OK;
@@ -559,278 +1192,1681 @@ error:
 }
 #endif
 
-int sgl_init(const struct sgl_context_options *opts)
-{
-#ifdef SGL_HAVE_EGL
-   if (opts->context.style != SGL_CONTEXT_GLES)
-      return sgl_init_glx(opts);
-   else
-      return sgl_init_egl(opts);
-#else
-   return sgl_init_glx(opts);
-#endif
-}
-
-void sgl_deinit(void)
+static void deinit_egl(void)
 {
 #ifdef SGL_HAVE_EGL
    if (g_egl_dpy)
    {
+      eglMakeCurrent(g_egl_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
       if (g_egl_ctx)
          eglDestroyContext(g_egl_dpy, g_egl_ctx);
       if (g_egl_surf)
          eglDestroySurface(g_egl_dpy, g_egl_surf);
       eglTerminate(g_egl_dpy);
    }
-#endif
 
+   g_egl_ctx  = EGL_NO_CONTEXT;
+   g_egl_surf = EGL_NO_SURFACE;
+   g_egl_dpy  = EGL_NO_DISPLAY;
+#endif
    g_egl = false;
+}
 
-   if (g_ctx)
+static void deinit_headless_fbo(void)
+{
+   if (g_fbo)
    {
-      glFinish();
-      glXMakeCurrent(g_dpy, None, NULL);
-      glXDestroyContext(g_dpy, g_ctx);
-      g_ctx = NULL;
+      g_pglDeleteFramebuffers(1, &g_fbo);
+      g_fbo = 0;
    }
 
-   if (g_win)
+   if (g_fbo_renderbuffers[0])
    {
-      XDestroyWindow(g_dpy, g_win);
-      g_win = None;
+      g_pglDeleteRenderbuffers(2, g_fbo_renderbuffers);
+      memset(g_fbo_renderbuffers, 0, sizeof(g_fbo_renderbuffers));
    }
+}
 
-   if (g_cmap)
+// Creates the FBO headless contexts render to.
+// Without FBO support, rendering goes to the pbuffer instead, if there is one.
+// *unsupported (if not NULL) tells that case apart from a framebuffer that can't be completed.
+static bool init_headless_fbo(unsigned width, unsigned height, unsigned samples, bool *unsupported)
+{
+   void (*gen_framebuffers)(GLsizei, GLuint*) =
+      (void (*)(GLsizei, GLuint*))sgl_get_proc_address("glGenFramebuffers");
+   void (*bind_framebuffer)(GLenum, GLuint) =
+      (void (*)(GLenum, GLuint))sgl_get_proc_address("glBindFramebuffer");
+   void (*gen_renderbuffers)(GLsizei, GLuint*) =
+      (void (*)(GLsizei, GLuint*))sgl_get_proc_address("glGenRenderbuffers");
+   void (*bind_renderbuffer)(GLenum, GLuint) =
+      (void (*)(GLenum, GLuint))sgl_get_proc_address("glBindRenderbuffer");
+   void (*renderbuffer_storage)(GLenum, GLenum, GLsizei, GLsizei) =
+      (void (*)(GLenum, GLenum, GLsizei, GLsizei))sgl_get_proc_address("glRenderbufferStorage");
+   void (*renderbuffer_storage_ms)(GLenum, GLsizei, GLenum, GLsizei, GLsizei) =
+      (void (*)(GLenum, GLsizei, GLenum, GLsizei, GLsizei))sgl_get_proc_address("glRenderbufferStorageMultisample");
+   void (*framebuffer_renderbuffer)(GLenum, GLenum, GLenum, GLuint) =
+      (void (*)(GLenum, GLenum, GLenum, GLuint))sgl_get_proc_address("glFramebufferRenderbuffer");
+   GLenum (*check_framebuffer_status)(GLenum) =
+      (GLenum (*)(GLenum))sgl_get_proc_address("glCheckFramebufferStatus");
+
+   g_pglDeleteFramebuffers = (void (*)(GLsizei, const GLuint*))sgl_get_proc_address("glDeleteFramebuffers");
+   g_pglDeleteRenderbuffers = (void (*)(GLsizei, const GLuint*))sgl_get_proc_address("glDeleteRenderbuffers");
+
+   if (!gen_framebuffers || !bind_framebuffer || !gen_renderbuffers || !bind_renderbuffer ||
+         !renderbuffer_storage || !framebuffer_renderbuffer || !check_framebuffer_status ||
+         !g_pglDeleteFramebuffers || !g_pglDeleteRenderbuffers)
    {
-      XFreeColormap(g_dpy, g_cmap);
-      g_cmap = None;
+      fprintf(stderr, "[SGL]: Framebuffer objects are not supported.\n");
+      if (unsupported)
+         *unsupported = true;
+      return false;
    }
 
-   if (g_should_reset_mode)
+   const GLenum formats[2] = { GL_RGBA8, GL_DEPTH24_STENCIL8 };
+
+   gen_renderbuffers(2, g_fbo_renderbuffers);
+   for (unsigned i = 0; i < 2; i++)
    {
-      XF86VidModeSwitchToMode(g_dpy, DefaultScreen(g_dpy), &g_desktop_mode);
-      XF86VidModeSetViewPort(g_dpy, DefaultScreen(g_dpy), 0, 0);
-      g_should_reset_mode = false;
+      bind_renderbuffer(GL_RENDERBUFFER, g_fbo_renderbuffers[i]);
+      if (samples > 1 && renderbuffer_storage_ms)
+         renderbuffer_storage_ms(GL_RENDERBUFFER, samples, formats[i], width, height);
+      else
+         renderbuffer_storage(GL_RENDERBUFFER, formats[i], width, height);
    }
+   bind_renderbuffer(GL_RENDERBUFFER, 0);
 
-   if (g_dpy)
+   gen_framebuffers(1, &g_fbo);
+   bind_framebuffer(GL_FRAMEBUFFER, g_fbo);
+   framebuffer_renderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, g_fbo_renderbuffers[0]);
+   framebuffer_renderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_fbo_renderbuffers[1]);
+   framebuffer_renderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, g_fbo_renderbuffers[1]);
+
+   if (check_framebuffer_status(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
    {
-      XCloseDisplay(g_dpy);
-      g_dpy = NULL;
+      fprintf(stderr, "[SGL]: Headless framebuffer is incomplete.\n");
+      bind_framebuffer(GL_FRAMEBUFFER, 0);
+      deinit_headless_fbo();
+      return false;
    }
 
-   g_inited = false;
+   glViewport(0, 0, width, height);
+   return true;
 }
 
-void sgl_swap_buffers(void)
-{
-   if (g_is_double_buffered && !g_egl)
-      glXSwapBuffers(g_dpy, g_win);
 #ifdef SGL_HAVE_EGL
-   else
-      eglSwapBuffers(g_egl_dpy, g_egl_surf);
-#endif
-}
-
-void sgl_set_swap_interval(unsigned interval)
+// Prefers Mesa's surfaceless platform, then the first EGL device.
+// Neither needs a display server.
+static EGLDisplay get_headless_egl_display(void)
 {
-   if (g_pglSwapInterval && !g_egl)
-      g_pglSwapInterval(interval);
-#ifdef SGL_HAVE_EGL
-   else
-      eglSwapInterval(g_egl_dpy, interval);
-#endif
+   PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+   PFNEGLQUERYDEVICESEXTPROC query_devices =
+      (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+   if (!get_platform_display)
+      return EGL_NO_DISPLAY;
+
+   EGLDisplay dpy = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+   if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, NULL, NULL))
+      return dpy;
+
+   EGLDeviceEXT device;
+   EGLint num_devices = 0;
+   if (query_devices && query_devices(1, &device, &num_devices) && num_devices > 0)
+   {
+      dpy = get_platform_display(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+      if (dpy != EGL_NO_DISPLAY && eglInitialize(dpy, NULL, NULL))
+         return dpy;
+   }
+
+   return EGL_NO_DISPLAY;
 }
 
-int sgl_check_resize(unsigned *width, unsigned *height)
+static bool init_headless_egl(const struct sgl_context_options *opts)
 {
-   XWindowAttributes target;
-   XGetWindowAttributes(g_dpy, g_win, &target);
+   bool gles = opts->context.style == SGL_CONTEXT_GLES;
 
-   if (target.width != g_last_width || target.height != g_last_height)
+   g_egl_dpy = get_headless_egl_display();
+   if (g_egl_dpy == EGL_NO_DISPLAY)
+      return false;
+
+   g_egl_api = gles ? EGL_OPENGL_ES_API : EGL_OPENGL_API;
+   if (!eglBindAPI(g_egl_api))
    {
-      g_resized = true;
-      g_last_width = target.width;
-      g_last_height = target.height;
+      fprintf(stderr, "[SGL]: eglBindAPI() failed.\n");
+      return false;
    }
 
-   if (g_resized)
+   const EGLint egl_attribs[] = {
+      EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+      EGL_RED_SIZE,        8,
+      EGL_GREEN_SIZE,      8,
+      EGL_BLUE_SIZE,       8,
+      EGL_ALPHA_SIZE,      8,
+      EGL_RENDERABLE_TYPE, gles ? (opts->context.major == 2 ? EGL_OPENGL_ES2_BIT : EGL_OPENGL_ES_BIT) : EGL_OPENGL_BIT,
+      EGL_NONE,
+   };
+
+   EGLConfig config;
+   EGLint num_configs;
+   if (!eglChooseConfig(g_egl_dpy, egl_attribs, &config, 1, &num_configs) || num_configs == 0)
    {
-      *width = g_last_width;
-      *height = g_last_height;
-      g_resized = false;
-      return SGL_TRUE;
+      fprintf(stderr, "[SGL]: eglChooseConfig() failed.\n");
+      return false;
    }
-   else
-      return SGL_FALSE;
-}
-
-static void handle_key_press(int key, int pressed);
-static void handle_button_press(int button, int pressed, int x, int y);
-static void handle_motion(int x, int y);
 
-int sgl_is_alive(void)
-{
-   int old_x = g_mouse_last_x;
-   int old_y = g_mouse_last_y;
+   g_egl_ctx = eglCreateContext(g_egl_dpy, config, EGL_NO_CONTEXT, init_egl_ctx_attribs(opts));
+   g_egl_config = config;
+   if (!g_egl_ctx)
+   {
+      fprintf(stderr, "[SGL]: Failed to create EGL context.\n");
+      return false;
+   }
 
-   XEvent event;
-   while (XPending(g_dpy))
+   // Without EGL_KHR_surfaceless_context, bind a pbuffer we never draw to.
+   if (!eglMakeCurrent(g_egl_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, g_egl_ctx))
    {
-      XNextEvent(g_dpy, &event);
-      switch (event.type)
+      const EGLint pbuffer_attribs[] = {
+         EGL_WIDTH,  1,
+         EGL_HEIGHT, 1,
+         EGL_NONE,
+      };
+
+      g_egl_surf = eglCreatePbufferSurface(g_egl_dpy, config, pbuffer_attribs);
+      if (!g_egl_surf || !eglMakeCurrent(g_egl_dpy, g_egl_surf, g_egl_surf, g_egl_ctx))
       {
-         case KeyPress:
-         case KeyRelease:
-            handle_key_press(XLookupKeysym(&event.xkey, 0), event.xkey.type == KeyPress);
-            break;
+         fprintf(stderr, "[SGL]: Failed to make EGL context current.\n");
+         return false;
+      }
+   }
 
-         case ButtonPress:
-         case ButtonRelease:
-            handle_button_press(event.xbutton.button, 
-                  event.xbutton.type == ButtonPress,
-                  event.xbutton.x,
-                  event.xbutton.y);
-            break;
+   g_egl = true;
+   return init_headless_fbo(opts->res.width, opts->res.height, opts->samples, NULL);
+}
+#endif
 
-         case MotionNotify:
-            handle_motion(event.xmotion.x, event.xmotion.y);
-            break;
+// Falls back to a pbuffer on a display server, e.g. Xvfb.
+static bool init_headless_glx(const struct sgl_context_options *opts)
+{
+   g_dpy = open_display();
+   if (!g_dpy)
+      return false;
 
-         case ClientMessage:
-            if ((Atom)event.xclient.data.l[0] == g_quit_atom)
-               g_quit = true;
-            break;
+   const int visual_attribs[] = {
+      GLX_DRAWABLE_TYPE    , GLX_PBUFFER_BIT,
+      GLX_RENDER_TYPE      , GLX_RGBA_BIT,
+      GLX_RED_SIZE         , 8,
+      GLX_GREEN_SIZE       , 8,
+      GLX_BLUE_SIZE        , 8,
+      GLX_ALPHA_SIZE       , 8,
+      GLX_DEPTH_SIZE       , 24,
+      GLX_STENCIL_SIZE     , 8,
+      None
+   };
 
-         case DestroyNotify:
-            g_quit = true;
-            break;
+   int nelements;
+   GLXFBConfig *fbc_temp = glXChooseFBConfig(g_dpy, DefaultScreen(g_dpy),
+         visual_attribs, &nelements);
+   if (!fbc_temp)
+      return false;
 
-         case MapNotify:
-            g_has_focus = true;
-            break;
+   GLXFBConfig fbc = fbc_temp[0];
+   XFree(fbc_temp);
 
-         case UnmapNotify:
-            g_has_focus = false;
-            break;
-      }
-   }
+   // Sized so it can be rendered to directly if FBOs are missing.
+   const int pbuffer_attribs[] = {
+      GLX_PBUFFER_WIDTH  , opts->res.width,
+      GLX_PBUFFER_HEIGHT , opts->res.height,
+      None
+   };
 
-   if (g_mouse_relative && g_input_cbs.mouse_move_cb)
-   {
-      int old_mouse_x = g_mouse_grabbed ? g_last_width >> 1 : old_x;
-      int old_mouse_y = g_mouse_grabbed ? g_last_height >> 1 : old_y;
+   g_pbuffer = glXCreatePbuffer(g_dpy, fbc, pbuffer_attribs);
+   if (!g_pbuffer)
+      return false;
 
-      int delta_x = g_mouse_last_x - old_mouse_x;
-      int delta_y = g_mouse_last_y - old_mouse_y;
-      
-      if (delta_x || delta_y)
-         g_input_cbs.mouse_move_cb(delta_x, delta_y);
-   }
+   g_ctx = create_glx_context(fbc, NULL, opts);
+   if (!g_ctx)
+      return false;
+   g_fbc = fbc;
 
-   if (g_mouse_grabbed)
+   if (!glXMakeContextCurrent(g_dpy, g_pbuffer, g_pbuffer, g_ctx))
    {
-      XWarpPointer(g_dpy, None, g_win, 0, 0, 0, 0,
-            g_last_width >> 1, g_last_height >> 1);
-      g_mouse_last_x = g_last_width >> 1;
-      g_mouse_last_y = g_last_height >> 1;
+      fprintf(stderr, "[SGL]: Failed to make GLX context current.\n");
+      return false;
    }
 
-   return !g_quit;
+   // Only render to the pbuffer if there are no FBOs at all.
+   bool unsupported = false;
+   return init_headless_fbo(opts->res.width, opts->res.height, opts->samples, &unsupported) || unsupported;
 }
 
-int sgl_has_focus(void)
+int sgl_init_headless(const struct sgl_context_options *opts)
 {
-   if (!sgl_is_alive())
-      return SGL_FALSE;
+   if (g_inited)
+      return SGL_ERROR;
 
-   Window win;
-   int rev;
-   XGetInputFocus(g_dpy, &win, &rev);
+   // There is no window size to fall back on.
+   if (!opts->res.width || !opts->res.height)
+   {
+      fprintf(stderr, "[SGL]: Headless contexts need a non-zero width and height.\n");
+      return SGL_ERROR;
+   }
 
-   return (win == g_win && g_has_focus) || g_should_reset_mode; // Fullscreen
-}
+   g_quit       = 0;
+   g_resized    = false;
+   g_num_events = 0;
+   g_headless   = true;
 
-void sgl_set_window_title(const char *name)
-{
-   if (name)
-      XStoreName(g_dpy, g_win, (char*)name);
+   // Nothing can take focus away.
+   g_has_focus  = true;
+   g_mapped     = true;
+
+#ifdef SGL_HAVE_EGL
+   bool ok = init_headless_egl(opts);
+   if (!ok)
+      deinit_egl();
+   if (!ok && opts->context.style != SGL_CONTEXT_GLES)
+      ok = init_headless_glx(opts);
+#else
+   bool ok = init_headless_glx(opts);
+#endif
+
+   if (!ok)
+   {
+      fprintf(stderr, "[SGL]: Failed to create headless context.\n");
+      goto error;
+   }
+
+   if (!init_gl_loader(opts))
+      goto error;
+   init_timing_mark(&g_init_timing.context);
+
+   g_last_width  = opts->res.width;
+   g_last_height = opts->res.height;
+
+   catch_signals();
+
+   init_frame_timing();
+   init_present_mode(opts);
+   init_timing_mark(&g_init_timing.setup);
+
+   g_inited = true;
+   return SGL_OK;
+
+error:
+   sgl_deinit();
+   return SGL_ERROR;
 }
 
-sgl_function_t sgl_get_proc_address(const char *sym)
+int sgl_init(const struct sgl_context_options *opts)
 {
-   return glXGetProcAddress((const GLubyte*)sym);
+   int ret;
+   profile_reset();
+   PROFILE_BEGIN(profile_start);
+
+   g_shared_contexts = opts->context.shared;
+   g_ctx_opts = *opts;
+   g_monitor_index = opts->res.monitor_index;
+
+#ifdef SGL_HAVE_XRANDR
+   // Drops the connection sgl_get_desktop_modes() used before init.
+   if (!g_dpy)
+      randr_deinit();
+#endif
+
+   memset(&g_init_timing, 0, sizeof(g_init_timing));
+   g_init_mark = get_time_usec();
+   int64_t init_start = g_init_mark;
+
+   if (opts->screen_type == SGL_SCREEN_HEADLESS)
+      ret = sgl_init_headless(opts);
+#ifdef SGL_HAVE_EGL
+   else if (opts->context.style == SGL_CONTEXT_GLES)
+      ret = sgl_init_egl(opts);
+#endif
+   else
+      ret = sgl_init_glx(opts);
+
+   g_init_timing.total = get_time_usec() - init_start;
+   PROFILE_END(SGL_PROFILE_INIT, profile_start);
+   return ret;
 }
 
-void sgl_get_handles(struct sgl_handles *handles)
+int sgl_get_init_timing(struct sgl_init_timing *timing)
 {
-   handles->dpy = g_dpy;
-   handles->win = g_win;
-   handles->ctx = g_ctx;
+   *timing = g_init_timing;
+   return SGL_OK;
 }
 
-// Input.
-struct key_bind
+void sgl_deinit(void)
 {
-   int x;
-   int sglk;
-};
+   bool was_inited = g_inited;
+   PROFILE_BEGIN(profile_start);
+
+   stop_input_thread();
+   __atomic_store_n(&g_raw_motion, false, __ATOMIC_RELEASE);
+   memset(&g_input_filter, 0, sizeof(g_input_filter));
+#ifdef SGL_HAVE_XINPUT2
+   memset(&g_xi2, 0, sizeof(g_xi2));
+#endif
 
-static const struct key_bind lut_binds[] = {
-   { XK_Left, SGLK_LEFT },
-   { XK_Right, SGLK_RIGHT },
-   { XK_Up, SGLK_UP },
-   { XK_Down, SGLK_DOWN },
-   { XK_Return, SGLK_RETURN },
-   { XK_Tab, SGLK_TAB },
-   { XK_Insert, SGLK_INSERT },
-   { XK_Delete, SGLK_DELETE },
-   { XK_Shift_R, SGLK_RSHIFT },
-   { XK_Shift_L, SGLK_LSHIFT },
-   { XK_Control_L, SGLK_LCTRL },
-   { XK_Alt_L, SGLK_LALT },
-   { XK_space, SGLK_SPACE },
-   { XK_Escape, SGLK_ESCAPE },
-   { XK_BackSpace, SGLK_BACKSPACE },
-   { XK_KP_Enter, SGLK_KP_ENTER },
-   { XK_KP_Add, SGLK_KP_PLUS },
-   { XK_KP_Subtract, SGLK_KP_MINUS },
-   { XK_KP_Multiply, SGLK_KP_MULTIPLY },
-   { XK_KP_Divide, SGLK_KP_DIVIDE },
-   { XK_grave, SGLK_BACKQUOTE },
-   { XK_Pause, SGLK_PAUSE },
-   { XK_KP_0, SGLK_KP0 },
-   { XK_KP_1, SGLK_KP1 },
-   { XK_KP_2, SGLK_KP2 },
-   { XK_KP_3, SGLK_KP3 },
-   { XK_KP_4, SGLK_KP4 },
-   { XK_KP_5, SGLK_KP5 },
-   { XK_KP_6, SGLK_KP6 },
-   { XK_KP_7, SGLK_KP7 },
-   { XK_KP_8, SGLK_KP8 },
-   { XK_KP_9, SGLK_KP9 },
-   { XK_0, SGLK_0 },
-   { XK_1, SGLK_1 },
-   { XK_2, SGLK_2 },
-   { XK_3, SGLK_3 },
-   { XK_4, SGLK_4 },
+   while (g_windows)
+      sgl_window_destroy(g_windows);
+
+   if (g_frame_fence)
+   {
+      g_pglDeleteSync(g_frame_fence);
+      g_frame_fence = NULL;
+   }
+   g_adaptive_vsync = false;
+   g_limit_frames = false;
+   g_last_swap_begin = 0;
+   g_swap_interval = 0;
+
+   sgl_stop_input_recording();
+   sgl_stop_input_replay();
+   sgl_stop_recording();
+   sgl_stop_export();
+   sgl_stop_capture();
+   deinit_headless_fbo();
+   gl_dispatch_free(&g_gl_dispatch);
+   gl_extensions_free();
+   deinit_egl();
+
+   if (g_ctx)
+   {
+      glFinish();
+      glXMakeCurrent(g_dpy, None, NULL);
+      glXDestroyContext(g_dpy, g_ctx);
+      g_ctx = NULL;
+   }
+
+   if (g_pbuffer)
+   {
+      glXDestroyPbuffer(g_dpy, g_pbuffer);
+      g_pbuffer = None;
+   }
+
+   if (g_win)
+   {
+      XDestroyWindow(g_dpy, g_win);
+      g_win = None;
+   }
+
+   if (g_cmap)
+   {
+      XFreeColormap(g_dpy, g_cmap);
+      g_cmap = None;
+   }
+
+   if (g_should_reset_mode)
+   {
+#ifdef SGL_HAVE_XRANDR
+      if (g_randr.fullscreen)
+         randr_restore_mode();
+      else
+#endif
+      {
+         XF86VidModeSwitchToMode(g_dpy, DefaultScreen(g_dpy), &g_desktop_mode);
+         XF86VidModeSetViewPort(g_dpy, DefaultScreen(g_dpy), 0, 0);
+      }
+      g_should_reset_mode = false;
+   }
+   g_have_desktop_mode = false;
+
+#ifdef SGL_HAVE_XRANDR
+   randr_deinit();
+#endif
+
+   if (g_dpy)
+   {
+      XCloseDisplay(g_dpy);
+      g_dpy = NULL;
+   }
+
+   g_headless = false;
+   g_shared_contexts = false;
+   g_fbc = NULL;
+   g_ctx_major = 0;
+   g_ctx_minor = 0;
+   g_inited = false;
+
+   PROFILE_END(SGL_PROFILE_DEINIT, profile_start);
+   if (was_inited)
+      profile_dump();
+}
+
+static int64_t get_time_usec(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return (int64_t)tv.tv_sec * 1000000 + tv.tv_nsec / 1000;
+}
+
+static bool has_glx_extension(const char *ext)
+{
+   return gl_has_extension(ext);
+}
+
+static unsigned mode_refresh_period(const XF86VidModeModeInfo *mode)
+{
+   if (!mode->dotclock)
+      return 0;
+
+   // dotclock is in kHz.
+   return (unsigned)((uint64_t)mode->htotal * mode->vtotal * 1000 / mode->dotclock);
+}
+
+// Refresh period of the monitor the window was placed on.
+static unsigned desktop_refresh_period(void)
+{
+#ifdef SGL_HAVE_XRANDR
+   const struct randr_monitor *mon = randr_get_monitor(g_dpy, g_monitor_index);
+   if (mon && g_randr.modes[mon->first_mode].refresh_mhz)
+      return 1000000000u / g_randr.modes[mon->first_mode].refresh_mhz;
+#endif
+   return mode_refresh_period(get_desktop_mode());
+}
+
+// Presentation timestamps come from, in order of preference,
+// GLX_INTEL_swap_event completion events, GLX_OML_sync_control queries
+// after each swap, or CPU timestamps around the swap call.
+static void init_frame_timing(void)
+{
+   memset(g_frame_history, 0, sizeof(g_frame_history));
+   g_frame_count        = 0;
+   g_last_present_frame = 0;
+   g_last_present_msc   = 0;
+   g_missed_vblanks     = 0;
+   g_sbc_base           = 0;
+   g_swap_event_base    = 0;
+   g_timing_source      = SGL_TIMING_CPU;
+   g_refresh_period     = 0;
+   g_filter_frame       = 0;
+   g_filter_ust         = 0;
+   g_filter_interval    = 0.0;
+
+   if (g_headless)
+      return;
+   if (g_egl)
+   {
+      g_refresh_period = desktop_refresh_period();
+      return;
+   }
+
+   if (has_glx_extension("GLX_OML_sync_control"))
+   {
+      g_pglXGetSyncValuesOML = (Bool (*)(Display*, GLXDrawable, int64_t*, int64_t*, int64_t*))
+         glXGetProcAddress((const GLubyte*)"glXGetSyncValuesOML");
+      g_pglXGetMscRateOML = (Bool (*)(Display*, GLXDrawable, int32_t*, int32_t*))
+         glXGetProcAddress((const GLubyte*)"glXGetMscRateOML");
+
+      int32_t num, den;
+      if (g_pglXGetMscRateOML && g_pglXGetMscRateOML(g_dpy, g_win, &num, &den) && num > 0)
+         g_refresh_period = (unsigned)((int64_t)den * 1000000 / num);
+
+      int64_t ust, msc, sbc;
+      if (g_pglXGetSyncValuesOML && g_pglXGetSyncValuesOML(g_dpy, g_win, &ust, &msc, &sbc))
+      {
+         g_sbc_base = sbc;
+         g_timing_source = SGL_TIMING_OML;
+      }
+   }
+
+   if (!g_refresh_period)
+      g_refresh_period = desktop_refresh_period();
+
+   int error_base;
+   if (has_glx_extension("GLX_INTEL_swap_event") &&
+         glXQueryExtension(g_dpy, &error_base, &g_swap_event_base))
+   {
+      glXSelectEvent(g_dpy, g_win, GLX_BUFFER_SWAP_COMPLETE_INTEL_MASK);
+      g_timing_source = SGL_TIMING_INTEL_SWAP_EVENT;
+   }
+   else
+      g_swap_event_base = 0;
+}
+
+// Exponentially weighted average of time between presented frames.
+// Isolated hitches are not allowed to drag the estimate along.
+static void update_present_filter(uint64_t frame, int64_t ust)
+{
+   if (g_filter_frame && frame > g_filter_frame)
+   {
+      double interval = (double)(ust - g_filter_ust) / (frame - g_filter_frame);
+      if (g_filter_interval <= 0.0)
+         g_filter_interval = interval;
+      else if (interval < 3.0 * g_filter_interval)
+         g_filter_interval += (interval - g_filter_interval) * 0.125;
+   }
+
+   g_filter_frame = frame;
+   g_filter_ust = ust;
+}
+
+static void present_frame(int64_t sbc, int64_t ust, int64_t msc)
+{
+   uint64_t frame = sbc - g_sbc_base;
+   if (frame == 0 || frame > g_frame_count || g_frame_count - frame >= SGL_FRAME_STATS_HISTORY)
+      return;
+
+   struct sgl_frame_timing *timing = &g_frame_history[frame % SGL_FRAME_STATS_HISTORY];
+   if (timing->msc)
+      return;
+
+   timing->ust = ust;
+   timing->msc = msc;
+
+   if (g_last_present_frame && frame > g_last_present_frame && g_swap_interval)
+   {
+      uint64_t expected = (frame - g_last_present_frame) * g_swap_interval;
+      uint64_t elapsed = msc - g_last_present_msc;
+      if (elapsed > expected)
+         g_missed_vblanks += elapsed - expected;
+   }
+
+   g_last_present_frame = frame;
+   g_last_present_msc = msc;
+   update_present_filter(frame, ust);
+}
+
+static void record_swap(int64_t begin, int64_t end)
+{
+   g_frame_count++;
+
+   struct sgl_frame_timing *timing = &g_frame_history[g_frame_count % SGL_FRAME_STATS_HISTORY];
+   *timing = (struct sgl_frame_timing) {
+      .sbc            = g_frame_count,
+      .cpu_swap_begin = begin,
+      .cpu_swap_end   = end,
+   };
+
+   switch (g_timing_source)
+   {
+      case SGL_TIMING_OML:
+      {
+         int64_t ust, msc, sbc;
+         if (g_pglXGetSyncValuesOML(g_dpy, g_win, &ust, &msc, &sbc))
+            present_frame(sbc, ust, msc);
+         break;
+      }
+
+      case SGL_TIMING_CPU:
+      {
+         timing->ust = end;
+         update_present_filter(g_frame_count, end);
+
+         // Estimate missed vblanks from the time between swaps.
+         const struct sgl_frame_timing *prev = &g_frame_history[(g_frame_count - 1) % SGL_FRAME_STATS_HISTORY];
+         if (g_frame_count > 1 && g_refresh_period && g_swap_interval)
+         {
+            uint64_t vblanks = (end - prev->cpu_swap_end + g_refresh_period / 2) / g_refresh_period;
+            if (vblanks > g_swap_interval)
+               g_missed_vblanks += vblanks - g_swap_interval;
+         }
+         break;
+      }
+
+      default:
+         break;
+   }
+}
+
+static bool set_interval(int interval)
+{
+   // Nothing to wait for.
+   if (g_headless)
+      return interval == 0;
+
+#ifdef SGL_HAVE_EGL
+   if (g_egl)
+      return eglSwapInterval(g_egl_dpy, interval);
+#endif
+
+   if (g_pglXSwapIntervalEXT)
+   {
+      g_pglXSwapIntervalEXT(g_dpy, g_win, interval);
+      return true;
+   }
+
+   if (g_pglSwapInterval && interval >= 0)
+      return g_pglSwapInterval(interval) == 0;
+
+   return false;
+}
+
+// Emulated FIFO relaxed. Turns vsync off after consecutive frames miss
+// their vblank, and back on once frames have fit well within the refresh
+// period for a while. With vsync on, swaps are paced by the display, so
+// only the missed vblank count from record_swap() says a frame was late.
+static void update_adaptive_vsync(int64_t begin)
+{
+   if (g_swap_interval)
+   {
+      bool missed = g_missed_vblanks != g_adaptive_missed;
+      g_adaptive_missed = g_missed_vblanks;
+      g_adaptive_streak = missed ? g_adaptive_streak + 1 : 0;
+
+      if (g_adaptive_streak >= ADAPTIVE_VSYNC_MISSED_FRAMES)
+      {
+         set_interval(0);
+         g_swap_interval = 0;
+         g_adaptive_streak = 0;
+      }
+   }
+   else if (g_last_swap_begin)
+   {
+      // Unthrottled, the time between swaps is the real frame time.
+      int64_t frame_time = begin - g_last_swap_begin;
+      g_adaptive_streak = frame_time * 100 < g_refresh_period * 90 ? g_adaptive_streak + 1 : 0;
+
+      if (g_adaptive_streak >= ADAPTIVE_VSYNC_ON_TIME_FRAMES)
+      {
+         set_interval(1);
+         g_swap_interval = 1;
+         g_adaptive_streak = 0;
+         g_adaptive_missed = g_missed_vblanks;
+      }
+   }
+
+   g_last_swap_begin = begin;
+}
+
+// Emulated mailbox. Keeps at most one frame queued ahead of the display,
+// so the presented image is never older than one refresh.
+static void limit_frames_in_flight(void)
+{
+   if (!g_pglFenceSync)
+   {
+      glFinish();
+      return;
+   }
+
+   if (g_frame_fence)
+   {
+      g_pglClientWaitSync(g_frame_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+      g_pglDeleteSync(g_frame_fence);
+      g_frame_fence = NULL;
+   }
+}
+
+void sgl_swap_buffers(void)
+{
+   PROFILE_BEGIN(profile_start);
+   int64_t begin = get_time_usec();
+
+   if (g_adaptive_vsync)
+      update_adaptive_vsync(begin);
+   if (g_limit_frames)
+      limit_frames_in_flight();
+
+   capture_frame(g_last_width, g_last_height, g_frame_count + 1, begin);
+   capture_pump();
+
+   if (g_headless)
+      glFlush();
+   else if (g_is_double_buffered && !g_egl)
+      glXSwapBuffers(g_dpy, g_win);
+#ifdef SGL_HAVE_EGL
+   else
+      eglSwapBuffers(g_egl_dpy, g_egl_surf);
+#endif
+
+   if (g_limit_frames && g_pglFenceSync)
+      g_frame_fence = g_pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+   record_swap(begin, get_time_usec());
+   PROFILE_END(SGL_PROFILE_SWAP, profile_start);
+}
+
+static int apply_present_mode(int mode)
+{
+   g_adaptive_vsync = false;
+   g_limit_frames = false;
+   g_last_swap_begin = 0;
+   g_adaptive_missed = g_missed_vblanks;
+   g_adaptive_streak = 0;
+
+   if (g_frame_fence)
+   {
+      g_pglDeleteSync(g_frame_fence);
+      g_frame_fence = NULL;
+   }
+
+   switch (mode)
+   {
+      case SGL_PRESENT_MODE_IMMEDIATE:
+         if (!set_interval(0))
+            return g_present_mode = SGL_PRESENT_MODE_DEFAULT;
+         g_swap_interval = 0;
+         break;
+
+      case SGL_PRESENT_MODE_FIFO_RELAXED:
+         if (g_has_swap_control_tear && set_interval(-1))
+         {
+            g_swap_interval = 1;
+            break;
+         }
+
+         // Can't emulate without knowing when a frame is late.
+         if (!set_interval(1))
+            return g_present_mode = SGL_PRESENT_MODE_DEFAULT;
+         g_swap_interval = 1;
+         if (!g_refresh_period)
+            return g_present_mode = SGL_PRESENT_MODE_FIFO;
+         g_adaptive_vsync = true;
+         break;
+
+      case SGL_PRESENT_MODE_MAILBOX:
+         if (!set_interval(1))
+            return g_present_mode = SGL_PRESENT_MODE_DEFAULT;
+         g_swap_interval = 1;
+         g_limit_frames = true;
+
+         load_sync_procs();
+         break;
+
+      default:
+         mode = SGL_PRESENT_MODE_FIFO;
+         if (!set_interval(1))
+            return g_present_mode = SGL_PRESENT_MODE_DEFAULT;
+         g_swap_interval = 1;
+         break;
+   }
+
+   return g_present_mode = mode;
+}
+
+int sgl_set_present_mode(int mode)
+{
+   return apply_present_mode(mode);
+}
+
+void sgl_set_swap_interval(unsigned interval)
+{
+   int mode = apply_present_mode(interval ? SGL_PRESENT_MODE_FIFO : SGL_PRESENT_MODE_IMMEDIATE);
+   if (mode == SGL_PRESENT_MODE_FIFO && interval > 1 && set_interval(interval))
+      g_swap_interval = interval;
+}
+
+static void init_present_mode(const struct sgl_context_options *opts)
+{
+   if (opts->present_mode != SGL_PRESENT_MODE_DEFAULT)
+      apply_present_mode(opts->present_mode);
+   else
+      sgl_set_swap_interval(opts->swap_interval);
+}
+
+int sgl_predict_next_present(struct sgl_present_prediction *pred)
+{
+   if (!g_inited || !g_filter_frame)
+      return SGL_ERROR;
+
+   // With real vblank timestamps and vsync, frames land on multiples of the refresh period.
+   bool vblank_locked = g_timing_source != SGL_TIMING_CPU && g_refresh_period && g_swap_interval;
+   double interval = vblank_locked ? (double)g_refresh_period * g_swap_interval : g_filter_interval;
+   if (interval <= 0.0)
+      interval = g_refresh_period;
+   if (interval <= 0.0)
+      return SGL_ERROR;
+
+   // Frames already swapped but not yet presented are queued ahead of this one.
+   uint64_t frames_ahead = g_frame_count + 1 - g_filter_frame;
+   double predicted = g_filter_ust + frames_ahead * interval;
+
+   // If we're running late, the frame can't be shown before the next slot after now.
+   double now = get_time_usec();
+   if (predicted < now)
+   {
+      double step = vblank_locked ? g_refresh_period : interval;
+      predicted += step * (uint64_t)((now - predicted) / step + 1.0);
+   }
+
+   pred->present_time   = (int64_t)predicted;
+   pred->frame_interval = (unsigned)(interval + 0.5);
+   return SGL_OK;
+}
+
+int sgl_get_frame_stats(struct sgl_frame_stats *stats)
+{
+   if (!g_inited)
+      return SGL_ERROR;
+
+   unsigned num = g_frame_count < SGL_FRAME_STATS_HISTORY ? g_frame_count : SGL_FRAME_STATS_HISTORY;
+
+   stats->source         = g_timing_source;
+   stats->refresh_period = g_refresh_period;
+   stats->missed_vblanks = g_missed_vblanks;
+   stats->frames         = g_frame_count;
+   stats->num_history    = num;
+
+   for (unsigned i = 0; i < num; i++)
+      stats->history[i] = g_frame_history[(g_frame_count - num + 1 + i) % SGL_FRAME_STATS_HISTORY];
+
+   return SGL_OK;
+}
+
+int sgl_check_resize(unsigned *width, unsigned *height)
+{
+   PROFILE_BEGIN(profile_start);
+   int ret = SGL_FALSE;
+
+   // Size is tracked from ConfigureNotify in sgl_is_alive().
+   if (g_resized)
+   {
+      *width = g_last_width;
+      *height = g_last_height;
+      g_resized = false;
+      ret = SGL_TRUE;
+   }
+
+   PROFILE_END(SGL_PROFILE_RESIZE, profile_start);
+   return ret;
+}
+
+static bool translate_event(const XEvent *event, struct sgl_event *ev);
+static bool translate_raw_motion(Display *dpy, XEvent *event, struct sgl_event *ev);
+static bool wants_event(int type);
+static void queue_event(const struct sgl_event *ev);
+static void handle_input(const struct sgl_event *ev);
+static void input_ring_drain(void);
+
+static void update_focus(bool focused, bool mapped)
+{
+   bool was_focused = g_has_focus && g_mapped;
+   g_has_focus = focused;
+   g_mapped = mapped;
+
+   if (was_focused != (focused && mapped))
+   {
+      // Releases while unfocused are never seen.
+      memset(g_input_filter.keys_down, 0, sizeof(g_input_filter.keys_down));
+
+      const struct sgl_event ev = {
+         .type      = SGL_EVENT_FOCUS,
+         .pressed   = focused && mapped,
+         .timestamp = g_last_event_time,
+      };
+      handle_input(&ev);
+   }
+}
+
+static void pump_events(void)
+{
+   PROFILE_BEGIN(profile_start);
+   int old_x = g_mouse_last_x;
+   int old_y = g_mouse_last_y;
+   input_log_frame();
+
+   XEvent event;
+   while (g_dpy && XPending(g_dpy))
+   {
+      XNextEvent(g_dpy, &event);
+
+      if (g_swap_event_base && event.type == g_swap_event_base + GLX_BufferSwapComplete)
+      {
+         const GLXBufferSwapComplete *swap = (const GLXBufferSwapComplete*)&event;
+         present_frame(swap->sbc, swap->ust, swap->msc);
+         continue;
+      }
+
+#ifdef SGL_HAVE_XRANDR
+      if (randr_handle_event(&event))
+         continue;
+#endif
+
+      struct sgl_event ev;
+      if (translate_raw_motion(g_dpy, &event, &ev))
+      {
+         handle_input(&ev);
+         continue;
+      }
+
+      struct sgl_window *win = g_windows ? find_window(event.xany.window) : NULL;
+      if (win)
+      {
+         handle_window_event(win, &event);
+         continue;
+      }
+
+      if (translate_event(&event, &ev))
+      {
+         handle_input(&ev);
+         continue;
+      }
+
+      switch (event.type)
+      {
+         case MappingNotify:
+            XRefreshKeyboardMapping(&event.xmapping);
+            if (event.xmapping.request == MappingKeyboard)
+               init_keycode_map(g_dpy, g_keycode_map);
+            break;
+
+         case ClientMessage:
+            if ((Atom)event.xclient.data.l[0] == g_quit_atom)
+               g_quit = true;
+            break;
+
+         case DestroyNotify:
+            g_quit = true;
+            break;
+
+         case ConfigureNotify:
+            if (event.xconfigure.window == g_win &&
+                  (event.xconfigure.width != g_last_width || event.xconfigure.height != g_last_height))
+            {
+               g_resized = true;
+               g_last_width = event.xconfigure.width;
+               g_last_height = event.xconfigure.height;
+            }
+            break;
+
+         case MapNotify:
+            update_focus(g_has_focus, true);
+            break;
+
+         case UnmapNotify:
+            update_focus(g_has_focus, false);
+            break;
+
+         case FocusIn:
+         case FocusOut:
+            // Ignore focus changes caused by grabs and pointer focus.
+            if (event.xfocus.mode == NotifyGrab || event.xfocus.mode == NotifyUngrab ||
+                  event.xfocus.detail == NotifyPointer || event.xfocus.detail == NotifyInferior)
+               break;
+            update_focus(event.type == FocusIn, g_mapped);
+            break;
+      }
+   }
+
+   if (g_input_thread_running)
+      input_ring_drain();
+
+   if (g_mouse_relative && !g_raw_motion && wants_event(SGL_EVENT_MOUSE_MOVE))
+   {
+      int old_mouse_x = g_mouse_grabbed ? g_last_width >> 1 : old_x;
+      int old_mouse_y = g_mouse_grabbed ? g_last_height >> 1 : old_y;
+
+      int delta_x = g_mouse_last_x - old_mouse_x;
+      int delta_y = g_mouse_last_y - old_mouse_y;
+      
+      if (delta_x || delta_y)
+      {
+         const struct sgl_event ev = {
+            .type      = SGL_EVENT_MOUSE_MOVE,
+            .x         = delta_x,
+            .y         = delta_y,
+            .timestamp = g_last_event_time,
+         };
+         queue_event(&ev);
+      }
+   }
+
+   if (g_mouse_grabbed && !g_raw_motion)
+   {
+      XWarpPointer(g_dpy, None, g_win, 0, 0, 0, 0,
+            g_last_width >> 1, g_last_height >> 1);
+      g_mouse_last_x = g_last_width >> 1;
+      g_mouse_last_y = g_last_height >> 1;
+   }
+
+   input_replay_pump();
+   PROFILE_END(SGL_PROFILE_PUMP, profile_start);
+}
+
+// Hands queued events to the input callbacks.
+// Events without a matching callback are kept for sgl_poll_events().
+static void dispatch_events(void)
+{
+   PROFILE_BEGIN(profile_start);
+   unsigned kept = 0;
+   for (unsigned i = 0; i < g_num_events; i++)
+   {
+      const struct sgl_event *ev = &g_events[i];
+      const struct sgl_input_callbacks *cbs = ev->window ? &ev->window->cbs : &g_input_cbs;
+      switch (ev->type)
+      {
+         case SGL_EVENT_KEY:
+            if (cbs->key_cb)
+            {
+               PROFILE_INPUT(ev);
+               cbs->key_cb(ev->code, ev->pressed);
+               continue;
+            }
+            break;
+
+         case SGL_EVENT_MOUSE_BUTTON:
+            if (cbs->mouse_button_cb)
+            {
+               PROFILE_INPUT(ev);
+               cbs->mouse_button_cb(ev->code, ev->pressed, ev->x, ev->y);
+               continue;
+            }
+            break;
+
+         case SGL_EVENT_MOUSE_MOVE:
+            if (cbs->mouse_move_cb)
+            {
+               PROFILE_INPUT(ev);
+               cbs->mouse_move_cb(ev->x, ev->y);
+               continue;
+            }
+            break;
+
+         case SGL_EVENT_FOCUS:
+            if (cbs->focus_cb)
+            {
+               cbs->focus_cb(ev->pressed);
+               continue;
+            }
+            break;
+      }
+
+      g_events[kept++] = *ev;
+   }
+
+   g_num_events = kept;
+   PROFILE_END(SGL_PROFILE_DISPATCH, profile_start);
+}
+
+int sgl_is_alive(void)
+{
+   pump_events();
+   dispatch_events();
+   return !g_quit;
+}
+
+unsigned sgl_poll_events(struct sgl_event *events, unsigned max_events)
+{
+   pump_events();
+
+   unsigned num = g_num_events < max_events ? g_num_events : max_events;
+   for (unsigned i = 0; i < num; i++)
+      PROFILE_INPUT(&g_events[i]);
+
+   memcpy(events, g_events, num * sizeof(*events));
+   memmove(g_events, g_events + num, (g_num_events - num) * sizeof(*events));
+   g_num_events -= num;
+   return num;
+}
+
+// Focus is tracked from FocusIn/FocusOut and MapNotify/UnmapNotify in sgl_is_alive().
+int sgl_has_focus(void)
+{
+   return (g_has_focus && g_mapped) || g_should_reset_mode; // Fullscreen
+}
+
+void sgl_set_window_title(const char *name)
+{
+   if (name && g_win)
+      XStoreName(g_dpy, g_win, (char*)name);
+}
+
+unsigned sgl_get_framebuffer(void)
+{
+   return g_fbo;
+}
+
+sgl_function_t sgl_get_proc_address(const char *sym)
+{
+#ifdef SGL_HAVE_EGL
+   if (g_egl)
+      return (sgl_function_t)eglGetProcAddress(sym);
+#endif
+   return glXGetProcAddress((const GLubyte*)sym);
+}
+
+void sgl_get_handles(struct sgl_handles *handles)
+{
+   handles->dpy = g_dpy;
+   handles->win = g_win;
+   handles->ctx = g_ctx;
+}
+
+// Shared contexts and fences.
+struct sgl_shared_context
+{
+   struct gl_dispatch dispatch;
+   GLXContext ctx;
+   GLXPbuffer pbuffer;
+#ifdef SGL_HAVE_EGL
+   EGLContext egl_ctx;
+   EGLSurface egl_surf;
+#endif
+};
+
+static bool load_sync_procs(void)
+{
+   if (!g_pglFenceSync)
+   {
+      g_pglFenceSync = (GLsync (*)(GLenum, GLbitfield))sgl_get_proc_address("glFenceSync");
+      g_pglClientWaitSync = (GLenum (*)(GLsync, GLbitfield, GLuint64))sgl_get_proc_address("glClientWaitSync");
+      g_pglWaitSync = (void (*)(GLsync, GLbitfield, GLuint64))sgl_get_proc_address("glWaitSync");
+      g_pglDeleteSync = (void (*)(GLsync))sgl_get_proc_address("glDeleteSync");
+      if (!g_pglClientWaitSync || !g_pglWaitSync || !g_pglDeleteSync)
+         g_pglFenceSync = NULL;
+   }
+
+   return g_pglFenceSync;
+}
+
+#ifdef SGL_HAVE_EGL
+static bool create_shared_egl_context(struct sgl_shared_context *ctx)
+{
+   ctx->egl_ctx = eglCreateContext(g_egl_dpy, g_egl_config, g_egl_ctx, g_egl_ctx_attribs[0] == EGL_NONE ? NULL : g_egl_ctx_attribs);
+   if (!ctx->egl_ctx)
+      return false;
+
+   // Without EGL_KHR_surfaceless_context, worker threads need a pbuffer to be current.
+   if (gl_has_extension("EGL_KHR_surfaceless_context"))
+      return true;
+
+   const EGLint pbuffer_attribs[] = {
+      EGL_WIDTH,  1,
+      EGL_HEIGHT, 1,
+      EGL_NONE,
+   };
+
+   ctx->egl_surf = eglCreatePbufferSurface(g_egl_dpy, g_egl_config, pbuffer_attribs);
+   if (!ctx->egl_surf)
+   {
+      eglDestroyContext(g_egl_dpy, ctx->egl_ctx);
+      return false;
+   }
+
+   return true;
+}
+#endif
+
+static bool create_shared_glx_context(struct sgl_shared_context *ctx)
+{
+   ctx->ctx = create_glx_context(g_fbc, g_ctx, &g_ctx_opts);
+   if (!ctx->ctx)
+      return false;
+
+   // The window's config may not support pbuffers. Contexts from
+   // glXCreateContextAttribsARB can then be made current without a drawable.
+   const int pbuffer_attribs[] = {
+      GLX_PBUFFER_WIDTH  , 1,
+      GLX_PBUFFER_HEIGHT , 1,
+      None
+   };
+
+   ctx->pbuffer = glXCreatePbuffer(g_dpy, g_fbc, pbuffer_attribs);
+   if (!ctx->pbuffer && g_ctx_opts.context.style != SGL_CONTEXT_MODERN)
+   {
+      glXDestroyContext(g_dpy, ctx->ctx);
+      return false;
+   }
+
+   return true;
+}
+
+struct sgl_shared_context *sgl_create_shared_context(void)
+{
+   if (!g_inited || !g_shared_contexts)
+   {
+      fprintf(stderr, "[SGL]: Shared contexts must be enabled in sgl_init().\n");
+      return NULL;
+   }
+
+   struct sgl_shared_context *ctx = calloc(1, sizeof(*ctx));
+   if (!ctx)
+      return NULL;
+
+#ifdef SGL_HAVE_EGL
+   bool ok = g_egl ? create_shared_egl_context(ctx) : create_shared_glx_context(ctx);
+#else
+   bool ok = create_shared_glx_context(ctx);
+#endif
+
+   if (!ok)
+   {
+      fprintf(stderr, "[SGL]: Failed to create shared context.\n");
+      free(ctx);
+      return NULL;
+   }
+
+   if (!gl_dispatch_init(&ctx->dispatch, g_ctx_opts.gl.procs, g_ctx_opts.gl.num_procs))
+   {
+      sgl_destroy_shared_context(ctx);
+      return NULL;
+   }
+
+   // Loaded here so fences are ready before worker threads use them.
+   load_sync_procs();
+   return ctx;
+}
+
+int sgl_make_current_shared(struct sgl_shared_context *ctx)
+{
+   g_gl_current = ctx ? &ctx->dispatch : NULL;
+
+#ifdef SGL_HAVE_EGL
+   if (g_egl)
+   {
+      // The bound API is per thread.
+      eglBindAPI(g_egl_api);
+      if (!ctx)
+         return eglMakeCurrent(g_egl_dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) ? SGL_OK : SGL_ERROR;
+      return eglMakeCurrent(g_egl_dpy, ctx->egl_surf, ctx->egl_surf, ctx->egl_ctx) ? SGL_OK : SGL_ERROR;
+   }
+#endif
+
+   if (!ctx)
+      return glXMakeContextCurrent(g_dpy, None, None, NULL) ? SGL_OK : SGL_ERROR;
+   return glXMakeContextCurrent(g_dpy, ctx->pbuffer, ctx->pbuffer, ctx->ctx) ? SGL_OK : SGL_ERROR;
+}
+
+void sgl_destroy_shared_context(struct sgl_shared_context *ctx)
+{
+   if (!ctx)
+      return;
+
+#ifdef SGL_HAVE_EGL
+   if (ctx->egl_ctx)
+      eglDestroyContext(g_egl_dpy, ctx->egl_ctx);
+   if (ctx->egl_surf)
+      eglDestroySurface(g_egl_dpy, ctx->egl_surf);
+#endif
+
+   if (ctx->ctx)
+      glXDestroyContext(g_dpy, ctx->ctx);
+   if (ctx->pbuffer)
+      glXDestroyPbuffer(g_dpy, ctx->pbuffer);
+
+   gl_dispatch_free(&ctx->dispatch);
+   free(ctx);
+}
+
+struct sgl_fence *sgl_fence_insert(void)
+{
+   if (!load_sync_procs())
+      return NULL;
+
+   GLsync sync = g_pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+   // Other contexts can only see the fence once it reaches the GPU.
+   glFlush();
+   return (struct sgl_fence*)sync;
+}
+
+void sgl_fence_wait_gpu(struct sgl_fence *fence)
+{
+   if (fence)
+      g_pglWaitSync((GLsync)fence, 0, GL_TIMEOUT_IGNORED);
+}
+
+int sgl_fence_wait(struct sgl_fence *fence, uint64_t timeout)
+{
+   if (!fence)
+      return SGL_TRUE;
+
+   GLenum ret = g_pglClientWaitSync((GLsync)fence, 0, timeout);
+   return ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED;
+}
+
+void sgl_fence_delete(struct sgl_fence *fence)
+{
+   if (fence)
+      g_pglDeleteSync((GLsync)fence);
+}
+
+// Other windows.
+static Bool is_window_event(Display *d, XEvent *e, char *arg)
+{
+   (void)d;
+   return e->xany.window == *(const Window*)arg;
+}
+
+static struct sgl_window *find_window(Window win)
+{
+   for (struct sgl_window *w = g_windows; w; w = w->next)
+      if (w->win == win)
+         return w;
+   return NULL;
+}
+
+static void window_queue_event(struct sgl_window *win, struct sgl_event *ev)
+{
+   g_last_event_time = ev->timestamp;
+   if (!window_wants_event(win, ev->type))
+      return;
+
+   ev->window = win;
+   queue_event(ev);
+}
+
+static void window_update_focus(struct sgl_window *win, bool focused, bool mapped)
+{
+   bool was_focused = win->has_focus && win->mapped;
+   win->has_focus = focused;
+   win->mapped = mapped;
+
+   if (was_focused != (focused && mapped))
+   {
+      memset(g_input_filter.keys_down, 0, sizeof(g_input_filter.keys_down));
+
+      struct sgl_event ev = {
+         .type      = SGL_EVENT_FOCUS,
+         .pressed   = focused && mapped,
+         .timestamp = g_last_event_time,
+      };
+      window_queue_event(win, &ev);
+   }
+}
+
+// Counterpart of pump_events() for windows other than the main one.
+static void handle_window_event(struct sgl_window *win, const XEvent *event)
+{
+   struct sgl_event ev;
+   if (translate_event(event, &ev))
+   {
+      window_queue_event(win, &ev);
+      return;
+   }
+
+   switch (event->type)
+   {
+      case ClientMessage:
+         if ((Atom)event->xclient.data.l[0] == g_quit_atom)
+            win->closed = true;
+         break;
+
+      case DestroyNotify:
+         win->closed = true;
+         break;
+
+      case ConfigureNotify:
+         if (event->xconfigure.width != win->width || event->xconfigure.height != win->height)
+         {
+            win->resized = true;
+            win->width = event->xconfigure.width;
+            win->height = event->xconfigure.height;
+         }
+         break;
+
+      case MapNotify:
+         window_update_focus(win, win->has_focus, true);
+         break;
+
+      case UnmapNotify:
+         window_update_focus(win, win->has_focus, false);
+         break;
+
+      case FocusIn:
+      case FocusOut:
+         if (event->xfocus.mode == NotifyGrab || event->xfocus.mode == NotifyUngrab ||
+               event->xfocus.detail == NotifyPointer || event->xfocus.detail == NotifyInferior)
+            break;
+         window_update_focus(win, event->type == FocusIn, win->mapped);
+         break;
+   }
+}
+
+struct sgl_window *sgl_window_create(const struct sgl_window_options *opts)
+{
+   if (!g_inited || g_headless)
+   {
+      fprintf(stderr, "[SGL]: Windows can only be created next to a main window.\n");
+      return NULL;
+   }
+
+   XVisualInfo *vi = NULL;
+#ifdef SGL_HAVE_EGL
+   if (g_egl)
+   {
+      EGLint vid = 0;
+      XVisualInfo vis_template;
+      int num_visuals = 0;
+      if (eglGetConfigAttrib(g_egl_dpy, g_egl_config, EGL_NATIVE_VISUAL_ID, &vid))
+      {
+         vis_template.visualid = vid;
+         vi = XGetVisualInfo(g_dpy, VisualIDMask, &vis_template, &num_visuals);
+      }
+   }
+   else
+#endif
+      vi = glXGetVisualFromFBConfig(g_dpy, g_fbc);
+
+   if (!vi)
+      return NULL;
+
+   struct sgl_window *win = calloc(1, sizeof(*win));
+   if (!win)
+   {
+      XFree(vi);
+      return NULL;
+   }
+
+   // Same visual as the main window, so the main context can render to it.
+   XSetWindowAttributes swa = {
+      .colormap     = win->cmap = XCreateColormap(g_dpy, RootWindow(g_dpy, vi->screen), vi->visual, AllocNone),
+      .border_pixel = 0,
+      .event_mask   = SGL_WINDOW_EVENT_MASK,
+   };
+
+   win->width  = opts->res.width;
+   win->height = opts->res.height;
+   win->win = XCreateWindow(g_dpy, RootWindow(g_dpy, vi->screen),
+         0, 0, win->width, win->height, 0,
+         vi->depth, InputOutput, vi->visual,
+         CWBorderPixel | CWColormap | CWEventMask, &swa);
+   XSetWindowBackground(g_dpy, win->win, 0);
+   XFree(vi);
+
+#ifdef SGL_HAVE_EGL
+   if (g_egl)
+   {
+      win->egl_surf = eglCreateWindowSurface(g_egl_dpy, g_egl_config, win->win, NULL);
+      if (!win->egl_surf)
+      {
+         fprintf(stderr, "[SGL]: Failed to create EGL surface.\n");
+         XDestroyWindow(g_dpy, win->win);
+         XFreeColormap(g_dpy, win->cmap);
+         free(win);
+         return NULL;
+      }
+   }
+#endif
+
+   if (opts->title)
+      XStoreName(g_dpy, win->win, (char*)opts->title);
+   if (g_quit_atom)
+      XSetWMProtocols(g_dpy, win->win, &g_quit_atom, 1);
+   XMapWindow(g_dpy, win->win);
+
+   XEvent event;
+   XIfEvent(g_dpy, &event, glx_wait_notify, (char*)&win->win);
+
+   Window focus;
+   int rev;
+   XGetInputFocus(g_dpy, &focus, &rev);
+   win->has_focus = focus == win->win;
+   win->mapped = true;
+
+   // Swaps of other windows should not wait for vblank on top of the main window's.
+   if (!g_egl && g_pglXSwapIntervalEXT)
+      g_pglXSwapIntervalEXT(g_dpy, win->win, 0);
+
+   win->next = g_windows;
+   g_windows = win;
+   select_input();
+   return win;
+}
+
+void sgl_window_destroy(struct sgl_window *win)
+{
+   if (!win)
+      return;
+
+   for (struct sgl_window **w = &g_windows; *w; w = &(*w)->next)
+   {
+      if (*w == win)
+      {
+         *w = win->next;
+         break;
+      }
+   }
+
+   // Queued events must not outlive their window.
+   unsigned kept = 0;
+   for (unsigned i = 0; i < g_num_events; i++)
+      if (g_events[i].window != win)
+         g_events[kept++] = g_events[i];
+   g_num_events = kept;
+
+#ifdef SGL_HAVE_EGL
+   if (win->egl_surf)
+   {
+      if (eglGetCurrentSurface(EGL_DRAW) == win->egl_surf)
+         sgl_window_make_current(NULL);
+      eglDestroySurface(g_egl_dpy, win->egl_surf);
+   }
+#endif
+
+   if (!g_egl && glXGetCurrentDrawable() == win->win)
+      sgl_window_make_current(NULL);
+
+   // Once unlinked, events for the window would be taken as the main window's. Drop them.
+   XSelectInput(g_dpy, win->win, NoEventMask);
+   XDestroyWindow(g_dpy, win->win);
+   XSync(g_dpy, False);
+
+   XEvent event;
+   while (XCheckIfEvent(g_dpy, &event, is_window_event, (char*)&win->win));
+
+   XFreeColormap(g_dpy, win->cmap);
+   free(win);
+}
+
+int sgl_window_make_current(struct sgl_window *win)
+{
+   // Windows render with the main context, so they share its dispatch table.
+   g_gl_current = &g_gl_dispatch;
+
+#ifdef SGL_HAVE_EGL
+   if (g_egl)
+   {
+      EGLSurface surf = win ? win->egl_surf : g_egl_surf;
+      return eglMakeCurrent(g_egl_dpy, surf, surf, g_egl_ctx) ? SGL_OK : SGL_ERROR;
+   }
+#endif
+
+   GLXDrawable drawable = win ? win->win : (g_pbuffer ? g_pbuffer : g_win);
+   return glXMakeContextCurrent(g_dpy, drawable, drawable, g_ctx) ? SGL_OK : SGL_ERROR;
+}
+
+void sgl_window_swap_buffers(struct sgl_window *win)
+{
+   if (!win)
+      sgl_swap_buffers();
+#ifdef SGL_HAVE_EGL
+   else if (g_egl)
+      eglSwapBuffers(g_egl_dpy, win->egl_surf);
+#endif
+   else
+      glXSwapBuffers(g_dpy, win->win);
+}
+
+int sgl_window_check_resize(struct sgl_window *win, unsigned *width, unsigned *height)
+{
+   if (!win)
+      return sgl_check_resize(width, height);
+   if (!win->resized)
+      return SGL_FALSE;
+
+   *width = win->width;
+   *height = win->height;
+   win->resized = false;
+   return SGL_TRUE;
+}
+
+void sgl_window_set_title(struct sgl_window *win, const char *title)
+{
+   if (!win)
+      sgl_set_window_title(title);
+   else if (title)
+      XStoreName(g_dpy, win->win, (char*)title);
+}
+
+void sgl_window_set_input_callbacks(struct sgl_window *win, const struct sgl_input_callbacks *cbs)
+{
+   if (!win)
+      sgl_set_input_callbacks(cbs);
+   else
+   {
+      win->cbs = *cbs;
+      select_input();
+   }
+}
+
+int sgl_window_has_focus(struct sgl_window *win)
+{
+   if (!win)
+      return sgl_has_focus();
+   return win->has_focus && win->mapped;
+}
+
+int sgl_window_is_open(struct sgl_window *win)
+{
+   if (!win)
+      return !g_quit;
+   return !win->closed;
+}
+
+// Input.
+struct key_bind
+{
+   int x;
+   int sglk;
+};
+
+static const struct key_bind lut_binds[] = {
+   { XK_BackSpace, SGLK_BACKSPACE },
+   { XK_Tab, SGLK_TAB },
+   { XK_Clear, SGLK_CLEAR },
+   { XK_Return, SGLK_RETURN },
+   { XK_Pause, SGLK_PAUSE },
+   { XK_Escape, SGLK_ESCAPE },
+   { XK_space, SGLK_SPACE },
+   { XK_exclam, SGLK_EXCLAIM },
+   { XK_quotedbl, SGLK_QUOTEDBL },
+   { XK_numbersign, SGLK_HASH },
+   { XK_dollar, SGLK_DOLLAR },
+   { XK_ampersand, SGLK_AMPERSAND },
+   { XK_apostrophe, SGLK_QUOTE },
+   { XK_parenleft, SGLK_LEFTPAREN },
+   { XK_parenright, SGLK_RIGHTPAREN },
+   { XK_asterisk, SGLK_ASTERISK },
+   { XK_plus, SGLK_PLUS },
+   { XK_comma, SGLK_COMMA },
+   { XK_minus, SGLK_MINUS },
+   { XK_period, SGLK_PERIOD },
+   { XK_slash, SGLK_SLASH },
+   { XK_0, SGLK_0 },
+   { XK_1, SGLK_1 },
+   { XK_2, SGLK_2 },
+   { XK_3, SGLK_3 },
+   { XK_4, SGLK_4 },
    { XK_5, SGLK_5 },
    { XK_6, SGLK_6 },
    { XK_7, SGLK_7 },
    { XK_8, SGLK_8 },
    { XK_9, SGLK_9 },
-   { XK_F1, SGLK_F1 },
-   { XK_F2, SGLK_F2 },
-   { XK_F3, SGLK_F3 },
-   { XK_F4, SGLK_F4 },
-   { XK_F5, SGLK_F5 },
-   { XK_F6, SGLK_F6 },
-   { XK_F7, SGLK_F7 },
-   { XK_F8, SGLK_F8 },
-   { XK_F9, SGLK_F9 },
-   { XK_F10, SGLK_F10 },
-   { XK_F11, SGLK_F11 },
-   { XK_F12, SGLK_F12 },
+   { XK_colon, SGLK_COLON },
+   { XK_semicolon, SGLK_SEMICOLON },
+   { XK_less, SGLK_LESS },
+   { XK_equal, SGLK_EQUALS },
+   { XK_greater, SGLK_GREATER },
+   { XK_question, SGLK_QUESTION },
+   { XK_at, SGLK_AT },
+   { XK_bracketleft, SGLK_LEFTBRACKET },
+   { XK_backslash, SGLK_BACKSLASH },
+   { XK_bracketright, SGLK_RIGHTBRACKET },
+   { XK_asciicircum, SGLK_CARET },
+   { XK_underscore, SGLK_UNDERSCORE },
+   { XK_grave, SGLK_BACKQUOTE },
    { XK_a, SGLK_a },
    { XK_b, SGLK_b },
    { XK_c, SGLK_c },
@@ -857,57 +2893,686 @@ static const struct key_bind lut_binds[] = {
    { XK_x, SGLK_x },
    { XK_y, SGLK_y },
    { XK_z, SGLK_z },
+   { XK_Delete, SGLK_DELETE },
+   { XK_KP_0, SGLK_KP0 },
+   { XK_KP_1, SGLK_KP1 },
+   { XK_KP_2, SGLK_KP2 },
+   { XK_KP_3, SGLK_KP3 },
+   { XK_KP_4, SGLK_KP4 },
+   { XK_KP_5, SGLK_KP5 },
+   { XK_KP_6, SGLK_KP6 },
+   { XK_KP_7, SGLK_KP7 },
+   { XK_KP_8, SGLK_KP8 },
+   { XK_KP_9, SGLK_KP9 },
+   { XK_KP_Decimal, SGLK_KP_PERIOD },
+   { XK_KP_Divide, SGLK_KP_DIVIDE },
+   { XK_KP_Multiply, SGLK_KP_MULTIPLY },
+   { XK_KP_Subtract, SGLK_KP_MINUS },
+   { XK_KP_Add, SGLK_KP_PLUS },
+   { XK_KP_Enter, SGLK_KP_ENTER },
+   { XK_KP_Equal, SGLK_KP_EQUALS },
+   // Keypad with NumLock off. The unshifted level is all that is looked at.
+   { XK_KP_Insert, SGLK_KP0 },
+   { XK_KP_End, SGLK_KP1 },
+   { XK_KP_Down, SGLK_KP2 },
+   { XK_KP_Next, SGLK_KP3 },
+   { XK_KP_Left, SGLK_KP4 },
+   { XK_KP_Begin, SGLK_KP5 },
+   { XK_KP_Right, SGLK_KP6 },
+   { XK_KP_Home, SGLK_KP7 },
+   { XK_KP_Up, SGLK_KP8 },
+   { XK_KP_Prior, SGLK_KP9 },
+   { XK_KP_Delete, SGLK_KP_PERIOD },
+   { XK_Up, SGLK_UP },
+   { XK_Down, SGLK_DOWN },
+   { XK_Right, SGLK_RIGHT },
+   { XK_Left, SGLK_LEFT },
+   { XK_Insert, SGLK_INSERT },
+   { XK_Home, SGLK_HOME },
+   { XK_End, SGLK_END },
+   { XK_Page_Up, SGLK_PAGEUP },
+   { XK_Page_Down, SGLK_PAGEDOWN },
+   { XK_F1, SGLK_F1 },
+   { XK_F2, SGLK_F2 },
+   { XK_F3, SGLK_F3 },
+   { XK_F4, SGLK_F4 },
+   { XK_F5, SGLK_F5 },
+   { XK_F6, SGLK_F6 },
+   { XK_F7, SGLK_F7 },
+   { XK_F8, SGLK_F8 },
+   { XK_F9, SGLK_F9 },
+   { XK_F10, SGLK_F10 },
+   { XK_F11, SGLK_F11 },
+   { XK_F12, SGLK_F12 },
+   { XK_F13, SGLK_F13 },
+   { XK_F14, SGLK_F14 },
+   { XK_F15, SGLK_F15 },
+   { XK_Num_Lock, SGLK_NUMLOCK },
+   { XK_Caps_Lock, SGLK_CAPSLOCK },
+   { XK_Scroll_Lock, SGLK_SCROLLOCK },
+   { XK_Shift_R, SGLK_RSHIFT },
+   { XK_Shift_L, SGLK_LSHIFT },
+   { XK_Control_R, SGLK_RCTRL },
+   { XK_Control_L, SGLK_LCTRL },
+   { XK_Alt_R, SGLK_RALT },
+   { XK_Alt_L, SGLK_LALT },
+   { XK_Meta_R, SGLK_RMETA },
+   { XK_Meta_L, SGLK_LMETA },
+   { XK_Super_L, SGLK_LSUPER },
+   { XK_Super_R, SGLK_RSUPER },
+   { XK_Mode_switch, SGLK_MODE },
+   { XK_Multi_key, SGLK_COMPOSE },
+   { XK_Help, SGLK_HELP },
+   { XK_Print, SGLK_PRINT },
+   { XK_Sys_Req, SGLK_SYSREQ },
+   { XK_Break, SGLK_BREAK },
+   { XK_Menu, SGLK_MENU },
+   { XF86XK_PowerOff, SGLK_POWER },
+   { XK_EuroSign, SGLK_EURO },
+   { XK_Undo, SGLK_UNDO },
 };
 
+static int keysym_to_sglk(KeySym sym)
+{
+   for (unsigned i = 0; i < sizeof(lut_binds) / sizeof(lut_binds[0]); i++)
+   {
+      if (sym == (KeySym)lut_binds[i].x)
+         return lut_binds[i].sglk;
+   }
+
+   return SGLK_UNKNOWN;
+}
+
+// Fetches the whole keyboard mapping in one request so that key events
+// can be translated with a single table lookup.
+// Keys are identified by their unshifted keysym, as XLookupKeysym(event, 0) did.
+// Shifted levels are only used for keycodes with nothing on the first level,
+// otherwise e.g. a key with an unknown unshifted symbol would report its shifted one.
+static void init_keycode_map(Display *dpy, unsigned short *map)
+{
+   memset(map, 0, sizeof(g_keycode_map));
+
+   int min_code, max_code, syms_per_code;
+   XDisplayKeycodes(dpy, &min_code, &max_code);
+
+   KeySym *syms = XGetKeyboardMapping(dpy, min_code,
+         max_code - min_code + 1, &syms_per_code);
+   if (!syms)
+      return;
+
+   for (int code = min_code; code <= max_code; code++)
+   {
+      const KeySym *code_syms = syms + (code - min_code) * syms_per_code;
+      if (code_syms[0] != NoSymbol)
+      {
+         map[code] = keysym_to_sglk(code_syms[0]);
+         continue;
+      }
+
+      for (int i = 1; i < syms_per_code; i++)
+      {
+         if (code_syms[i] != NoSymbol)
+         {
+            map[code] = keysym_to_sglk(code_syms[i]);
+            break;
+         }
+      }
+   }
+
+   XFree(syms);
+}
+
+static unsigned callback_event_mask(const struct sgl_input_callbacks *cbs)
+{
+   return (cbs->key_cb ? SGL_EVENT_MASK(SGL_EVENT_KEY) : 0) |
+      (cbs->mouse_button_cb ? SGL_EVENT_MASK(SGL_EVENT_MOUSE_BUTTON) : 0) |
+      (cbs->mouse_move_cb ? SGL_EVENT_MASK(SGL_EVENT_MOUSE_MOVE) : 0) |
+      (cbs->focus_cb ? SGL_EVENT_MASK(SGL_EVENT_FOCUS) : 0);
+}
+
+static bool wants_event(int type)
+{
+   return (g_event_mask | callback_event_mask(&g_input_cbs)) & SGL_EVENT_MASK(type);
+}
+
+static bool window_wants_event(const struct sgl_window *win, int type)
+{
+   return (g_event_mask | callback_event_mask(&win->cbs)) & SGL_EVENT_MASK(type);
+}
+
+static long input_event_mask(unsigned mask)
+{
+   return (mask & SGL_EVENT_MASK(SGL_EVENT_KEY) ? KeyPressMask | KeyReleaseMask : 0) |
+      (mask & SGL_EVENT_MASK(SGL_EVENT_MOUSE_BUTTON) ? ButtonPressMask | ButtonReleaseMask : 0) |
+      (mask & SGL_EVENT_MASK(SGL_EVENT_MOUSE_MOVE) ? PointerMotionMask : 0);
+}
+
+static void select_input(void)
+{
+   // Other windows are never read by the input thread.
+   for (struct sgl_window *win = g_windows; win; win = win->next)
+   {
+      XSelectInput(g_dpy, win->win, SGL_WINDOW_EVENT_MASK |
+            input_event_mask(g_event_mask | callback_event_mask(&win->cbs)));
+   }
+
+   if (!g_win)
+      return;
+
+   long input_mask = input_event_mask(g_event_mask | callback_event_mask(&g_input_cbs));
+
+   // Only one client may select button presses, so input goes exclusively
+   // to the input thread's connection when it is used.
+   if (g_input_dpy)
+   {
+      XSelectInput(g_dpy, g_win, SGL_WINDOW_EVENT_MASK);
+      XSelectInput(g_input_dpy, g_win, input_mask);
+      XFlush(g_input_dpy);
+      wake_input_thread();
+   }
+   else
+      XSelectInput(g_dpy, g_win, SGL_WINDOW_EVENT_MASK | input_mask);
+}
+
+// Seeds focus state once the window is mapped. Later changes arrive as events.
+static void init_focus(void)
+{
+   Window win;
+   int rev;
+   XGetInputFocus(g_dpy, &win, &rev);
+
+   g_has_focus = win == g_win;
+   g_mapped = true;
+}
+
 void sgl_set_input_callbacks(const struct sgl_input_callbacks *cbs)
 {
    g_input_cbs = *cbs;
-   XSelectInput(g_dpy, g_win,
-         (cbs->key_cb ? KeyPressMask | KeyReleaseMask : 0) |
-         (cbs->mouse_button_cb ? ButtonPressMask | ButtonReleaseMask : 0) |
-         (cbs->mouse_move_cb ? PointerMotionMask : 0));
+   select_input();
+}
+
+void sgl_set_event_mask(unsigned mask)
+{
+   g_event_mask = mask;
+   select_input();
+}
+
+static bool is_key_repeat(const struct sgl_event *ev)
+{
+   if (!g_input_filter.repeat_filter || ev->code < 0 || ev->code >= SGLK_LAST)
+      return false;
+
+   bool repeat = ev->pressed && g_input_filter.keys_down[ev->code];
+   g_input_filter.keys_down[ev->code] = ev->pressed;
+   return repeat;
+}
+
+// Merges ev into the last queued event if the policy for its type allows it.
+// Only consecutive events for the same window merge, so ordering between types is kept.
+static bool coalesce_event(const struct sgl_event *ev)
+{
+   if (!g_num_events || ev->type > SGL_EVENT_FOCUS)
+      return false;
+
+   int policy = g_input_filter.policy[ev->type];
+   struct sgl_event *last = &g_events[g_num_events - 1];
+   if (policy == SGL_COALESCE_NONE || last->type != ev->type || last->window != ev->window)
+      return false;
+
+   // Keys and buttons only merge with duplicates. Anything else would lose a press or release.
+   if ((ev->type == SGL_EVENT_KEY || ev->type == SGL_EVENT_MOUSE_BUTTON) &&
+         (last->code != ev->code || last->pressed != ev->pressed))
+      return false;
+
+   // Absolute positions can't be summed. Secondary windows never get relative motion.
+   if (policy == SGL_COALESCE_ACCUMULATE && ev->type == SGL_EVENT_MOUSE_MOVE &&
+         g_mouse_relative && !ev->window)
+   {
+      last->x += ev->x;
+      last->y += ev->y;
+      last->timestamp = ev->timestamp;
+   }
+   else
+      *last = *ev;
+
+   g_input_filter.merged[ev->type]++;
+   return true;
 }
 
-static void handle_key_press(int key, int pressed)
+static void queue_event(const struct sgl_event *ev)
 {
-   if (!g_input_cbs.key_cb)
+   if (ev->type == SGL_EVENT_KEY && is_key_repeat(ev))
+   {
+      g_input_filter.repeats_dropped++;
       return;
+   }
 
-   for (unsigned i = 0; i < sizeof(lut_binds) / sizeof(lut_binds[0]); i++)
+   // Logged before merging, so a replay merges the same way.
+   if (coalesce_event(ev))
+   {
+      input_log_event(ev);
+      return;
+   }
+
+   // Drop new events rather than old ones if nobody is draining the queue.
+   if (g_num_events < SGL_EVENT_QUEUE_SIZE)
+   {
+      g_events[g_num_events++] = *ev;
+      input_log_event(ev);
+   }
+}
+
+int sgl_set_event_coalescing(int type, int policy)
+{
+   if (type < SGL_EVENT_KEY || type > SGL_EVENT_FOCUS ||
+         policy < SGL_COALESCE_NONE || policy > SGL_COALESCE_ACCUMULATE)
+      return SGL_ERROR;
+
+   g_input_filter.policy[type] = policy;
+   return SGL_OK;
+}
+
+// Detectable autorepeat stops the server from sending a release before every repeated press.
+// It is per connection, so it is set on the one reading key events.
+int sgl_set_key_repeat_filter(int enable)
+{
+   if (!g_win)
+      return SGL_ERROR;
+
+   Bool supported = False;
+   XkbSetDetectableAutoRepeat(input_display(), enable ? True : False, &supported);
+   wake_input_thread();
+   if (enable && !supported)
+   {
+      fprintf(stderr, "[SGL]: Detectable autorepeat is not supported.\n");
+      return SGL_ERROR;
+   }
+
+   g_input_filter.repeat_filter = enable;
+   memset(g_input_filter.keys_down, 0, sizeof(g_input_filter.keys_down));
+   return SGL_OK;
+}
+
+int sgl_get_input_filter_stats(struct sgl_input_filter_stats *stats)
+{
+   memcpy(stats->merged, g_input_filter.merged, sizeof(stats->merged));
+   stats->repeats_dropped = g_input_filter.repeats_dropped;
+   return SGL_OK;
+}
+
+// Translates X input events to SGL events. Called from the input thread as well.
+static bool translate_event(const XEvent *event, struct sgl_event *ev)
+{
+   switch (event->type)
    {
-      if (key == lut_binds[i].x)
+      case KeyPress:
+      case KeyRelease:
       {
-         g_input_cbs.key_cb(lut_binds[i].sglk, pressed);
-         return;
+         const unsigned short *map = event->xany.display == g_input_dpy ? g_input_keycode_map : g_keycode_map;
+         unsigned keycode = event->xkey.keycode;
+         if (keycode >= sizeof(g_keycode_map) / sizeof(g_keycode_map[0]) || map[keycode] == SGLK_UNKNOWN)
+            return false;
+
+         *ev = (struct sgl_event) {
+            .type      = SGL_EVENT_KEY,
+            .pressed   = event->type == KeyPress,
+            .code      = map[keycode],
+            .timestamp = event->xkey.time,
+         };
+         return true;
       }
+
+      case ButtonPress:
+      case ButtonRelease:
+         *ev = (struct sgl_event) {
+            .type      = SGL_EVENT_MOUSE_BUTTON,
+            .pressed   = event->type == ButtonPress,
+            .code      = event->xbutton.button,
+            .x         = event->xbutton.x,
+            .y         = event->xbutton.y,
+            .timestamp = event->xbutton.time,
+         };
+         return true;
+
+      case MotionNotify:
+         *ev = (struct sgl_event) {
+            .type      = SGL_EVENT_MOUSE_MOVE,
+            .x         = event->xmotion.x,
+            .y         = event->xmotion.y,
+            .timestamp = event->xmotion.time,
+         };
+         return true;
+
+      default:
+         return false;
+   }
+}
+
+// Unaccelerated deltas from XI_RawMotion. Fractions are carried over to the next event.
+static bool translate_raw_motion(Display *dpy, XEvent *event, struct sgl_event *ev)
+{
+#ifdef SGL_HAVE_XINPUT2
+   XGenericEventCookie *cookie = &event->xcookie;
+   if (!__atomic_load_n(&g_raw_motion, __ATOMIC_ACQUIRE) || event->type != GenericEvent || cookie->extension != g_xi2.opcode ||
+         cookie->evtype != XI_RawMotion || !XGetEventData(dpy, cookie))
+      return false;
+
+   const XIRawEvent *raw = cookie->data;
+   const double *values = raw->raw_values;
+   double dx = g_xi2.rem_x, dy = g_xi2.rem_y;
+
+   // Values are packed. Only the axes in the mask have one.
+   if (raw->valuators.mask_len > 0 && XIMaskIsSet(raw->valuators.mask, 0))
+      dx += *values++;
+   if (raw->valuators.mask_len > 0 && XIMaskIsSet(raw->valuators.mask, 1))
+      dy += *values++;
+
+   *ev = (struct sgl_event) {
+      .type      = SGL_EVENT_RAW_MOTION,
+      .x         = (int)dx,
+      .y         = (int)dy,
+      .timestamp = raw->time,
+   };
+   g_xi2.rem_x = dx - ev->x;
+   g_xi2.rem_y = dy - ev->y;
+
+   XFreeEventData(dpy, cookie);
+   return ev->x || ev->y;
+#else
+   (void)dpy;
+   (void)event;
+   (void)ev;
+   return false;
+#endif
+}
+
+#ifdef SGL_HAVE_XINPUT2
+// Raw events are only reported on the root window, to the connection reading input.
+// XI 2.0 is enough: while we hold the pointer grab the raw events come to us.
+static void select_raw_motion(bool enable)
+{
+   Display *dpy = input_display();
+   if (g_xi2.dpy != dpy)
+   {
+      g_xi2.dpy = dpy;
+      g_xi2.available = false;
+
+      int event_base, error_base, major = 2, minor = 0;
+      if (XQueryExtension(dpy, "XInputExtension", &g_xi2.opcode, &event_base, &error_base) &&
+            XIQueryVersion(dpy, &major, &minor) == Success)
+         g_xi2.available = true;
+   }
+
+   if (!g_xi2.available || enable == g_raw_motion)
+      return;
+
+   unsigned char mask_bits[XIMaskLen(XI_RawMotion)] = {0};
+   XIEventMask mask = {
+      .deviceid = XIAllMasterDevices,
+      .mask_len = sizeof(mask_bits),
+      .mask     = mask_bits,
+   };
+   if (enable)
+      XISetMask(mask_bits, XI_RawMotion);
+
+   XISelectEvents(dpy, DefaultRootWindow(dpy), &mask, 1);
+   XFlush(dpy);
+   wake_input_thread();
+
+   // Published to the input thread along with g_xi2.opcode.
+   __atomic_store_n(&g_raw_motion, enable, __ATOMIC_RELEASE);
+}
+#endif
+
+static void handle_input(const struct sgl_event *ev)
+{
+   g_last_event_time = ev->timestamp;
+
+   if (ev->type == SGL_EVENT_RAW_MOTION)
+   {
+      // Raw motion is selected on the root window and keeps coming while another window has focus.
+      if (!g_mouse_relative || !sgl_has_focus() || !wants_event(SGL_EVENT_MOUSE_MOVE) ||
+            g_input_replay.active)
+         return;
+
+      struct sgl_event motion = *ev;
+      motion.type = SGL_EVENT_MOUSE_MOVE;
+      queue_event(&motion);
+      return;
+   }
+
+   // Live input is ignored while a log is replayed.
+   if (!wants_event(ev->type) || g_input_replay.active)
+      return;
+
+   if (ev->type == SGL_EVENT_MOUSE_MOVE)
+   {
+      g_mouse_last_x = ev->x;
+      g_mouse_last_y = ev->y;
+
+      // Relative motion is accumulated in pump_events().
+      if (g_mouse_relative)
+         return;
    }
+
+   queue_event(ev);
 }
 
-static void handle_button_press(int button, int pressed, int x, int y)
+// Single-producer/single-consumer ring between the input thread and the
+// thread calling sgl_is_alive(). Neither side ever waits on the other.
+static void input_ring_push(const struct sgl_event *ev)
 {
-   if (!g_input_cbs.mouse_button_cb)
+   unsigned head = g_input_ring.head;
+   unsigned tail = __atomic_load_n(&g_input_ring.tail, __ATOMIC_ACQUIRE);
+
+   if (head - tail > g_input_ring.mask)
+   {
+      __atomic_fetch_add(&g_input_ring.dropped, 1, __ATOMIC_RELAXED);
       return;
+   }
+
+   g_input_ring.events[head & g_input_ring.mask] = *ev;
+   __atomic_store_n(&g_input_ring.head, head + 1, __ATOMIC_RELEASE);
+
+   unsigned fill = head + 1 - tail;
+   if (fill > __atomic_load_n(&g_input_ring.high_water, __ATOMIC_RELAXED))
+      __atomic_store_n(&g_input_ring.high_water, fill, __ATOMIC_RELAXED);
+}
+
+static void input_ring_drain(void)
+{
+   unsigned tail = g_input_ring.tail;
+   unsigned head = __atomic_load_n(&g_input_ring.head, __ATOMIC_ACQUIRE);
+
+   for (; tail != head; tail++)
+      handle_input(&g_input_ring.events[tail & g_input_ring.mask]);
+
+   __atomic_store_n(&g_input_ring.tail, tail, __ATOMIC_RELEASE);
+}
+
+static void *input_thread(void *data)
+{
+   (void)data;
+
+   struct pollfd fds[2] = {
+      { .fd = ConnectionNumber(g_input_dpy), .events = POLLIN },
+      { .fd = g_input_wakeup[0], .events = POLLIN },
+   };
 
-   g_input_cbs.mouse_button_cb(button, pressed, x, y);
+   for (;;)
+   {
+      while (XPending(g_input_dpy))
+      {
+         XEvent event;
+         struct sgl_event ev;
+         XNextEvent(g_input_dpy, &event);
+         if (event.type == MappingNotify)
+         {
+            XRefreshKeyboardMapping(&event.xmapping);
+            if (event.xmapping.request == MappingKeyboard)
+               init_keycode_map(g_input_dpy, g_input_keycode_map);
+            continue;
+         }
+
+         if (translate_raw_motion(g_input_dpy, &event, &ev) || translate_event(&event, &ev))
+            input_ring_push(&ev);
+      }
+
+      if (poll(fds, 2, -1) < 0 && errno != EINTR)
+         break;
+
+      if (fds[1].revents)
+      {
+         char buf[64];
+         while (read(g_input_wakeup[0], buf, sizeof(buf)) > 0);
+         if (__atomic_load_n(&g_input_thread_quit, __ATOMIC_ACQUIRE))
+            break;
+      }
+   }
+
+   return NULL;
 }
 
-static void handle_motion(int x, int y)
+// Replies to requests the main thread makes on g_input_dpy can make Xlib read
+// events into its queue, where poll() won't see them. The thread is woken up
+// to check XPending() again.
+static void wake_input_thread(void)
 {
-   if (!g_input_cbs.mouse_move_cb)
+   if (!g_input_thread_running)
       return;
 
-   if (!g_mouse_relative)
-      g_input_cbs.mouse_move_cb(x, y);
+   // Non-blocking. If the pipe is full, the thread is already going to wake up.
+   char c = 0;
+   if (write(g_input_wakeup[1], &c, 1) < 0 && errno != EAGAIN)
+      fprintf(stderr, "[SGL]: Failed to wake up input thread.\n");
+}
+
+static unsigned next_pow2(unsigned v)
+{
+   unsigned ret = 1;
+   while (ret < v)
+      ret <<= 1;
+   return ret;
+}
+
+// Opens the connection used by the input thread.
+// Grabs must go through it as well, or grabbed input is reported to g_dpy.
+static bool init_input_display(const struct sgl_context_options *opts)
+{
+   if (!opts->input.threaded)
+      return true;
+
+   g_input_dpy = open_display();
+   if (!g_input_dpy)
+   {
+      fprintf(stderr, "[SGL]: Failed to open input display.\n");
+      return false;
+   }
+   init_keycode_map(g_input_dpy, g_input_keycode_map);
+
+   unsigned size = opts->input.queue_size ? opts->input.queue_size : SGL_EVENT_QUEUE_SIZE;
+   if (size > SGL_MAX_INPUT_QUEUE_SIZE)
+   {
+      fprintf(stderr, "[SGL]: Input queue size %u is larger than %u.\n", size, SGL_MAX_INPUT_QUEUE_SIZE);
+      return false;
+   }
+
+   size = next_pow2(size);
+   g_input_ring = (struct input_ring) {
+      .events = calloc(size, sizeof(struct sgl_event)),
+      .mask   = size - 1,
+   };
+
+   if (!g_input_ring.events)
+      return false;
+
+   return true;
+}
+
+static bool start_input_thread(void)
+{
+   if (!g_input_dpy)
+      return true;
+
+   select_input();
+
+   if (pipe(g_input_wakeup) < 0 ||
+         fcntl(g_input_wakeup[0], F_SETFL, O_NONBLOCK) < 0 ||
+         fcntl(g_input_wakeup[1], F_SETFL, O_NONBLOCK) < 0)
+   {
+      if (g_input_wakeup[0] >= 0)
+      {
+         close(g_input_wakeup[0]);
+         close(g_input_wakeup[1]);
+      }
+      g_input_wakeup[0] = g_input_wakeup[1] = -1;
+      return false;
+   }
+
+   g_input_thread_quit = false;
+
+   if (pthread_create(&g_input_thread, NULL, input_thread, NULL) != 0)
+   {
+      fprintf(stderr, "[SGL]: Failed to create input thread.\n");
+      return false;
+   }
+
+   g_input_thread_running = true;
+   return true;
+}
+
+static void stop_input_thread(void)
+{
+   if (g_input_thread_running)
+   {
+      __atomic_store_n(&g_input_thread_quit, true, __ATOMIC_RELEASE);
+      wake_input_thread();
+      pthread_join(g_input_thread, NULL);
+      g_input_thread_running = false;
+   }
+
+   if (g_input_wakeup[0] >= 0)
+   {
+      close(g_input_wakeup[0]);
+      close(g_input_wakeup[1]);
+      g_input_wakeup[0] = g_input_wakeup[1] = -1;
+   }
+
+   if (g_input_dpy)
+   {
+      XCloseDisplay(g_input_dpy);
+      g_input_dpy = NULL;
+   }
+
+   free(g_input_ring.events);
+   memset(&g_input_ring, 0, sizeof(g_input_ring));
+}
+
+int sgl_get_input_queue_stats(struct sgl_input_queue_stats *stats)
+{
+   if (!g_input_ring.events)
+      return SGL_ERROR;
+
+   unsigned head = __atomic_load_n(&g_input_ring.head, __ATOMIC_ACQUIRE);
+   unsigned tail = __atomic_load_n(&g_input_ring.tail, __ATOMIC_ACQUIRE);
 
-   g_mouse_last_x = x;
-   g_mouse_last_y = y;
+   stats->capacity   = g_input_ring.mask + 1;
+   stats->fill       = head - tail;
+   stats->high_water = __atomic_load_n(&g_input_ring.high_water, __ATOMIC_RELAXED);
+   stats->dropped    = __atomic_load_n(&g_input_ring.dropped, __ATOMIC_RELAXED);
+   return SGL_OK;
 }
 
 void sgl_set_mouse_mode(int grab, int relative, int visible)
 {
    g_mouse_relative = relative;
 
-   if (g_should_reset_mode) // Fullscreen
+#ifdef SGL_HAVE_XINPUT2
+   if (g_win)
+      select_raw_motion(relative);
+#endif
+
+   if (g_should_reset_mode || !g_win) // Fullscreen or headless
       return;
    
    g_mouse_grabbed = grab;
@@ -918,12 +3583,13 @@ void sgl_set_mouse_mode(int grab, int relative, int visible)
       XWarpPointer(g_dpy, None, g_win, 0, 0, 0, 0,
             g_last_width >> 1, g_last_height >> 1);
 
-      XGrabPointer(g_dpy, g_win, True,
+      XGrabPointer(input_display(), g_win, True,
             ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
             GrabModeAsync, GrabModeAsync, g_win, None, CurrentTime);
    }
    else
-      XUngrabPointer(g_dpy, CurrentTime);
+      XUngrabPointer(input_display(), CurrentTime);
+   wake_input_thread();
 
    if (visible)
       show_mouse();
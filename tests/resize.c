@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2011, Hans-Kristian Arntzen <maister@archlinux.us>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// Size tracking regression test. Run under Xvfb (make test), without a window manager.
+// A frame of sgl_is_alive(), sgl_check_resize() and sgl_has_focus() must not send a single
+// request to the server, so it can't wait on a round trip either. Requests are counted with
+// XNextRequest() on SGL's connection. Resizes come from a second connection.
+
+#define SGL_EXPOSE_INTERNAL
+#include "sgl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static int g_failures;
+
+#define CHECK(cond, ...) do { \
+   if (!(cond)) \
+   { \
+      fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+      fprintf(stderr, __VA_ARGS__); \
+      fputc('\n', stderr); \
+      g_failures++; \
+   } \
+} while (0)
+
+static double now(void)
+{
+   struct timespec tv;
+   clock_gettime(CLOCK_MONOTONIC, &tv);
+   return tv.tv_sec + tv.tv_nsec / 1e9;
+}
+
+// Runs frames until a resize is reported or a second passes. Returns the requests sent by the frames.
+static unsigned long run_frames(Display *dpy, int *resized, unsigned *width, unsigned *height)
+{
+   unsigned long requests = 0;
+   double end = now() + 1.0;
+
+   *resized = 0;
+   while (!*resized && now() < end)
+   {
+      unsigned long before = XNextRequest(dpy);
+      sgl_is_alive();
+      *resized = sgl_check_resize(width, height);
+      sgl_has_focus();
+      requests += XNextRequest(dpy) - before;
+
+      if (!*resized)
+      {
+         struct timespec tv = { 0, 1000000 };
+         nanosleep(&tv, NULL);
+      }
+   }
+
+   return requests;
+}
+
+static void test_windowed(void)
+{
+   const struct sgl_context_options opts = {
+      .res         = { .width = 320, .height = 240 },
+      .screen_type = SGL_SCREEN_WINDOWED,
+   };
+   if (!sgl_init(&opts))
+   {
+      CHECK(0, "sgl_init() failed");
+      return;
+   }
+
+   struct sgl_handles handles;
+   sgl_get_handles(&handles);
+
+   int resized;
+   unsigned width = 0, height = 0;
+   unsigned long requests = run_frames(handles.dpy, &resized, &width, &height);
+   CHECK(!resized, "unexpected resize to %ux%u", width, height);
+   CHECK(requests == 0, "%lu requests while idle", requests);
+
+   Display *other = XOpenDisplay(NULL);
+   CHECK(other, "failed to open second connection");
+   if (other)
+   {
+      XResizeWindow(other, handles.win, 400, 300);
+      XSync(other, False);
+
+      requests = run_frames(handles.dpy, &resized, &width, &height);
+      CHECK(resized && width == 400 && height == 300, "resize not seen, got %d %ux%u", resized, width, height);
+      CHECK(requests == 0, "%lu requests while resizing", requests);
+      XCloseDisplay(other);
+   }
+
+   sgl_deinit();
+}
+
+// The window covers the screen even though no size was requested.
+static void test_windowed_fullscreen(void)
+{
+   Display *dpy = XOpenDisplay(NULL);
+   if (!dpy)
+      return;
+   unsigned screen_width = DisplayWidth(dpy, DefaultScreen(dpy));
+   unsigned screen_height = DisplayHeight(dpy, DefaultScreen(dpy));
+   XCloseDisplay(dpy);
+
+   const struct sgl_context_options opts = {
+      .screen_type = SGL_SCREEN_WINDOWED_FULLSCREEN,
+   };
+   if (!sgl_init(&opts))
+   {
+      CHECK(0, "sgl_init() failed");
+      return;
+   }
+
+   unsigned width = 0, height = 0;
+   CHECK(sgl_check_resize(&width, &height) && width == screen_width && height == screen_height,
+         "initial size %ux%u, screen is %ux%u", width, height, screen_width, screen_height);
+
+   sgl_deinit();
+}
+
+int main(void)
+{
+   test_windowed();
+   test_windowed_fullscreen();
+
+   if (g_failures)
+   {
+      fprintf(stderr, "resize: %d failures\n", g_failures);
+      return EXIT_FAILURE;
+   }
+
+   printf("resize: ok\n");
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Runs a command against a private Xvfb server with Mesa's software renderer,
+# e.g. tests/xvfb.sh tests/resize. With SGL_USE_DISPLAY set, $DISPLAY is used as is.
+
+if [ -n "$SGL_USE_DISPLAY" ]; then
+   exec "$@"
+fi
+
+if ! command -v Xvfb >/dev/null 2>&1; then
+   echo "xvfb.sh: Xvfb not found." >&2
+   exit 1
+fi
+
+n=99
+while [ -e "/tmp/.X$n-lock" ]; do
+   n=$((n + 1))
+done
+
+Xvfb ":$n" -screen 0 1280x720x24 -nolisten tcp >/dev/null 2>&1 &
+pid=$!
+trap 'kill $pid 2>/dev/null' EXIT INT TERM
+
+i=0
+while [ ! -e "/tmp/.X11-unix/X$n" ]; do
+   i=$((i + 1))
+   if [ $i -gt 100 ]; then
+      echo "xvfb.sh: Xvfb did not start." >&2
+      exit 1
+   fi
+   sleep 0.05
+done
+
+DISPLAY=":$n" LIBGL_ALWAYS_SOFTWARE=1 "$@"